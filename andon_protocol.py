@@ -0,0 +1,139 @@
+"""
+Andon station <-> collector wire protocol
+Shared by client.py (the station) and server.py (the reference collector).
+
+Legacy protocol (server protocol = legacy):
+    One TCP connection per event. The station sends a single JSON object
+    and the collector answers with the two bytes "OK" and closes.
+
+Framed protocol (version 2):
+    One long-lived TCP connection per station. Every message in either
+    direction is a 4-byte big-endian length followed by the payload.
+
+    station -> collector
+        {"type": "hello", "device_name": ..., "protocol": 2, "encodings": [...]}
+        {"type": "batch", "base": n, "events": [{..., "seq": n}, ...]}  (JSON)
+        bin1 batch frame (see below), if negotiated
+        {"type": "notice", "event": {...}}  unsequenced, not acknowledged
+    collector -> station
+        {"type": "welcome", "protocol": 2, "encoding": ..., "ack": n}
+        {"type": "ack", "ack": n, "sack": [[lo, hi], ...]}
+
+    Sequence numbers increase per device. "ack" is cumulative: every event
+    up to and including n has been received. "sack" lists further received
+    ranges. "base" is the lowest sequence number the station may still send,
+    so gaps below it (events discarded on the station) don't stall "ack".
+    The welcome carries the collector's cumulative ack for the device so a
+    reconnecting station only retransmits what is actually missing.
+
+    One station process may serve several logical devices. Sequence numbers
+    and acks then belong to the session's device_name, while each event
+    carries the device_name of the logical device it came from.
+
+Event times:
+    "ts_ms" is epoch milliseconds (UTC) and is authoritative. "timestamp" is
+    the same instant as ISO 8601 local time with milliseconds and the UTC
+    offset, e.g. 2026-03-02T14:05:09.137+01:00. bin1 carries ts_ms only; the
+    collector renders timestamp in its own zone. "time_diff_sec" is measured
+    on the station's monotonic clock and is never negative.
+
+Chatter summaries:
+    A pin toggling faster than the station's threshold is summarized rather
+    than reported edge by edge: state "CHATTER", time_diff_sec is the period
+    covered, plus "toggles", "high_sec", "low_sec", "first_ts_ms" and
+    "last_ts_ms" (null if there were no toggles), "level" (the pin's level at
+    the end of the period) and "final" (true once the pin has settled).
+    Summaries always travel as JSON batches.
+"""
+
+import json
+import struct
+import time
+
+# Framed protocol: every message is a 4-byte big-endian length followed by the payload
+FRAME_HEADER = struct.Struct('!I')
+MAX_FRAME_SIZE = 1024 * 1024
+PROTOCOL_VERSION = 2
+
+# Event encodings negotiated in the hello/welcome handshake. JSON is always
+# understood and is used for any batch the compact encoding cannot represent.
+SUPPORTED_ENCODINGS = ('bin1', 'json')
+
+# bin1: fixed-layout binary batch frame. The device name is implied by the
+# session, timestamps are epoch milliseconds and durations whole milliseconds.
+# Batches holding events of other logical devices (multi-station) use JSON.
+BIN1_MAGIC = 0xA7
+BIN1_VERSION = 1
+BIN1_HEADER = struct.Struct('!BBQH')  # magic, version, base seq, event count
+BIN1_RECORD = struct.Struct('!QhBIq')  # seq, pin, state, time_diff ms, timestamp ms
+BIN1_STATES = {'LOW': 0, 'HIGH': 1}
+BIN1_STATE_NAMES = {value: name for name, value in BIN1_STATES.items()}
+BIN1_FIELDS = frozenset(('device_name', 'pin', 'state', 'time_diff_sec', 'timestamp', 'ts_ms', 'seq'))
+
+class TimestampFormatter:
+    """Renders epoch milliseconds as ISO 8601 local time with the UTC offset.
+
+    The date, time and offset are formatted once per second and reused, so
+    a burst of edges costs one strftime rather than one each.
+    """
+    def __init__(self):
+        self.cached = (None, '', '')  # second, prefix, offset suffix
+    
+    def format(self, ts_ms):
+        second, millis = divmod(ts_ms, 1000)
+        cached_second, prefix, suffix = self.cached
+        if second != cached_second:
+            local = time.localtime(second)
+            offset = local.tm_gmtoff
+            sign = '-' if offset < 0 else '+'
+            offset = abs(offset) // 60
+            prefix = time.strftime('%Y-%m-%dT%H:%M:%S', local)
+            suffix = f"{sign}{offset // 60:02d}:{offset % 60:02d}"
+            self.cached = (second, prefix, suffix)
+        return f"{prefix}.{millis:03d}{suffix}"
+
+class ProtocolError(Exception):
+    """Raised when the server sends something that violates the framed protocol"""
+    pass
+
+def encode_batch(encoding, device_name, base, events):
+    """Encode a batch frame payload, falling back to JSON if bin1 can't carry it"""
+    if encoding == 'bin1':
+        payload = encode_bin1(device_name, base, events)
+        if payload is not None:
+            return payload
+    return json.dumps({'type': 'batch', 'base': base, 'events': events}).encode('utf-8')
+
+def encode_bin1(device_name, base, events):
+    """Encode events as bin1 records; returns None if any event doesn't fit the layout"""
+    parts = [BIN1_HEADER.pack(BIN1_MAGIC, BIN1_VERSION, base, len(events))]
+    for event in events:
+        state = BIN1_STATES.get(event['state'])
+        if (state is None or event.get('device_name') != device_name or 'ts_ms' not in event
+                or not BIN1_FIELDS.issuperset(event)):
+            return None
+        time_diff_ms = min(max(round(event['time_diff_sec'] * 1000), 0), 0xFFFFFFFF)
+        parts.append(BIN1_RECORD.pack(event['seq'], event['pin'], state, time_diff_ms, event['ts_ms']))
+    return b''.join(parts)
+
+def decode_bin1(payload, device_name):
+    """Decode a bin1 batch frame into (base, events)"""
+    if len(payload) < BIN1_HEADER.size:
+        raise ProtocolError("Truncated binary batch frame")
+    magic, version, base, count = BIN1_HEADER.unpack_from(payload)
+    if magic != BIN1_MAGIC or version != BIN1_VERSION:
+        raise ProtocolError(f"Unsupported binary frame {magic:#x} v{version}")
+    if len(payload) != BIN1_HEADER.size + count * BIN1_RECORD.size:
+        raise ProtocolError("Truncated binary batch frame")
+    
+    events = []
+    for seq, pin, state, time_diff_ms, ts_ms in BIN1_RECORD.iter_unpack(payload[BIN1_HEADER.size:]):
+        events.append({
+            'device_name': device_name,
+            'pin': pin,
+            'state': BIN1_STATE_NAMES.get(state, 'UNKNOWN'),
+            'time_diff_sec': time_diff_ms / 1000.0,
+            'ts_ms': ts_ms,
+            'seq': seq
+        })
+    return base, events
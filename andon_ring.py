@@ -0,0 +1,171 @@
+"""
+Andon local event ring
+Shared by client.py (the producer) and local consumers on the station such
+as displays and stack-light drivers, which can follow pin changes without
+going through the collector.
+
+The ring is a memory-mapped file (by default under /dev/shm) holding a
+header and a power-of-two number of fixed-size slots. The station is the
+only writer. Any number of processes can read it, each at its own pace.
+
+    header  magic "ANDR", version, slot size, slot count, producer epoch,
+            write sequence (number of events ever published)
+    slot    seq, pin, state (0 LOW, 1 HIGH), flags (reserved), time_diff ms,
+            ts_ms, CLOCK_MONOTONIC ns of the edge
+
+Event n (counting from 1) lives in slot n % slots. The writer clears the
+slot's seq, writes the payload, stores seq = n and then advances the header's
+write sequence. A reader expecting event n checks the slot's seq before and
+after unpacking it. An older seq means the event isn't there yet; a newer
+one means the writer lapped the reader, which skips ahead and counts the
+events it lost. Readers never write to the ring.
+"""
+
+import mmap
+import os
+import struct
+import time
+from collections import namedtuple
+
+RING_MAGIC = b'ANDR'
+RING_VERSION = 1
+RING_HEADER = struct.Struct('<4sHHIIQQ')  # magic, version, slot size, slots, reserved, epoch, write seq
+RING_HEADER_SIZE = 64
+RING_WRITE_SEQ_OFFSET = 24
+RING_SLOT = struct.Struct('<QhBBIqQ')  # seq, pin, state, flags, time_diff ms, ts_ms, timestamp_ns
+RING_SEQ = struct.Struct('<Q')
+
+RingEvent = namedtuple('RingEvent', 'seq pin state time_diff_ms ts_ms timestamp_ns')
+
+class RingError(Exception):
+    """Raised when a ring file is missing, foreign or from an incompatible version"""
+    pass
+
+class RingWriter:
+    """Single producer side of the ring (the station)"""
+    def __init__(self, path, slots=4096):
+        if slots < 2 or slots & (slots - 1):
+            raise ValueError("ring slots must be a power of two")
+        self.path = path
+        self.slots = slots
+        self.mask = slots - 1
+        self.write_seq = 0
+        
+        # Build the new ring aside and swap it in, so readers of a previous
+        # producer's ring notice the replacement instead of seeing it reset
+        size = RING_HEADER_SIZE + slots * RING_SLOT.size
+        tmp_path = f"{path}.{os.getpid()}.tmp"
+        fd = os.open(tmp_path, os.O_RDWR | os.O_CREAT | os.O_TRUNC, 0o644)
+        try:
+            os.ftruncate(fd, size)
+            self.map = mmap.mmap(fd, size)
+        finally:
+            os.close(fd)
+        RING_HEADER.pack_into(self.map, 0, RING_MAGIC, RING_VERSION, RING_SLOT.size, slots, 0,
+                              time.time_ns(), 0)
+        os.replace(tmp_path, path)
+    
+    def publish(self, pin, state, time_diff_ms, ts_ms, timestamp_ns):
+        """Append one event; callers must serialize calls"""
+        seq = self.write_seq + 1
+        offset = RING_HEADER_SIZE + (seq & self.mask) * RING_SLOT.size
+        RING_SEQ.pack_into(self.map, offset, 0)
+        RING_SLOT.pack_into(self.map, offset, seq, pin, state, 0,
+                            min(max(time_diff_ms, 0), 0xFFFFFFFF), ts_ms, timestamp_ns)
+        RING_SEQ.pack_into(self.map, RING_WRITE_SEQ_OFFSET, seq)
+        self.write_seq = seq
+    
+    def close(self):
+        self.map.close()
+
+class RingReader:
+    """Consumer side of the ring; any number may follow one writer.
+
+    Events are unpacked straight from the shared mapping. A new reader
+    starts at the newest event unless from_start is set, in which case it
+    begins with the oldest event still in the ring.
+    """
+    def __init__(self, path, from_start=False):
+        self.path = path
+        self.map = None
+        self.lost = 0
+        self.open(from_start)
+    
+    def open(self, from_start):
+        try:
+            fd = os.open(self.path, os.O_RDONLY)
+        except FileNotFoundError:
+            raise RingError(f"No event ring at {self.path}")
+        try:
+            self.inode = os.fstat(fd).st_ino
+            self.map = mmap.mmap(fd, 0, access=mmap.ACCESS_READ)
+        finally:
+            os.close(fd)
+        
+        magic, version, slot_size, slots, _, self.epoch, write_seq = RING_HEADER.unpack_from(self.map)
+        if magic != RING_MAGIC or version != RING_VERSION or slot_size != RING_SLOT.size:
+            raise RingError(f"{self.path} is not a version {RING_VERSION} event ring")
+        self.slots = slots
+        self.mask = slots - 1
+        self.next_seq = max(write_seq - slots + 1, 1) if from_start else write_seq + 1
+    
+    def write_seq(self):
+        return RING_SEQ.unpack_from(self.map, RING_WRITE_SEQ_OFFSET)[0]
+    
+    def poll(self, max_events=256):
+        """Events published since the last call, oldest first"""
+        events = []
+        write_seq = self.write_seq()
+        if write_seq - self.next_seq + 1 > self.slots:
+            # Lapped while away: everything older than one ring is gone
+            skip_to = write_seq - self.slots + 1
+            self.lost += skip_to - self.next_seq
+            self.next_seq = skip_to
+        
+        while self.next_seq <= write_seq and len(events) < max_events:
+            offset = RING_HEADER_SIZE + (self.next_seq & self.mask) * RING_SLOT.size
+            record = RING_SLOT.unpack_from(self.map, offset)
+            if record[0] == self.next_seq and RING_SEQ.unpack_from(self.map, offset)[0] == self.next_seq:
+                events.append(RingEvent._make(record[:3] + record[4:]))
+                self.next_seq += 1
+            elif record[0] < self.next_seq:
+                break  # being written right now
+            else:
+                # Overwritten under us: resume from the oldest event still present
+                skip_to = max(self.write_seq() - self.slots + 1, self.next_seq + 1)
+                self.lost += skip_to - self.next_seq
+                self.next_seq = skip_to
+        return events
+    
+    def wait(self, timeout=None, interval=0.0002):
+        """Poll until events arrive or timeout seconds pass; follows a restarted producer"""
+        deadline = None if timeout is None else time.monotonic() + timeout
+        checked = time.monotonic()
+        while True:
+            events = self.poll()
+            if events:
+                return events
+            now = time.monotonic()
+            if deadline is not None and now >= deadline:
+                return []
+            if now - checked >= 1.0:
+                checked = now
+                self.reopen_if_replaced()
+            time.sleep(interval)
+    
+    def reopen_if_replaced(self):
+        """Switch to a new ring if the producer restarted and replaced the file"""
+        try:
+            inode = os.stat(self.path).st_ino
+        except FileNotFoundError:
+            return False
+        if inode == self.inode:
+            return False
+        self.map.close()
+        self.open(from_start=True)
+        return True
+    
+    def close(self):
+        if self.map:
+            self.map.close()
+            self.map = None
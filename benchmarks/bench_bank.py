@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+"""
+Bank sampling cost versus pin count
+Measures the bank backend's per-sample cost for 4, 16 and 26 pins, idle and
+with edges, next to a per-pin scan that reads and compares every pin on
+each sample (the cost model of one object per pin). Also reports the CPU
+the sampling thread takes at the configured interval. Uses the simulated
+line bank, so it runs without GPIO hardware; on the Pi the single bulk
+read is one ioctl where a per-pin scan is one per pin.
+
+Usage: python3 benchmarks/bench_bank.py [--counts 4,16,26] [--samples 200000] [--json]
+"""
+
+import argparse
+import json
+import resource
+import time
+
+from bench_common import BENCH_PINS
+import client
+
+def make_source(pins):
+    source = client.BankSamplingEdgeSource(pins, {pin: 0 for pin in pins}, simulated=True)
+    source.on_edge = lambda pin, level, timestamp_ns: None
+    return source
+
+def bank_idle(pins, samples):
+    source = make_source(pins)
+    sample = source.sample
+    start = time.perf_counter_ns()
+    for _ in range(samples):
+        sample()
+    return (time.perf_counter_ns() - start) / samples
+
+def bank_busy(pins, samples):
+    """One pin toggles on every sample"""
+    source = make_source(pins)
+    bank = source.bank
+    sample = source.sample
+    pin = pins[-1]
+    level = True
+    start = time.perf_counter_ns()
+    for _ in range(samples):
+        level = not level
+        bank.inject(pin, level)
+        sample()
+    return (time.perf_counter_ns() - start) / samples
+
+def per_pin_idle(pins, samples):
+    """Read and compare each pin individually on every sample"""
+    bank = client.SimulatedLineBank(pins)
+    levels = {pin: bank.get_value(pin) for pin in pins}
+    get_value = bank.get_value
+    start = time.perf_counter_ns()
+    for _ in range(samples):
+        for pin in pins:
+            level = get_value(pin)
+            if level != levels[pin]:
+                levels[pin] = level
+    return (time.perf_counter_ns() - start) / samples
+
+def sampler_cpu(pins, interval_ms, seconds):
+    """CPU share of the sampling thread running at interval_ms"""
+    source = client.BankSamplingEdgeSource(pins, {pin: 0 for pin in pins}, interval_ms, simulated=True)
+    before = resource.getrusage(resource.RUSAGE_SELF)
+    source.start(lambda pin, level, timestamp_ns: None)
+    time.sleep(seconds)
+    source.close()
+    after = resource.getrusage(resource.RUSAGE_SELF)
+    cpu = (after.ru_utime + after.ru_stime) - (before.ru_utime + before.ru_stime)
+    return cpu / seconds * 100, source.samples / seconds, source.overruns
+
+def main():
+    parser = argparse.ArgumentParser(description="Bank sampling cost versus pin count")
+    parser.add_argument('--counts', default='4,16,26', help='pin counts to compare')
+    parser.add_argument('--samples', type=int, default=200000)
+    parser.add_argument('--interval-ms', type=float, default=1.0, help='sampling interval for the CPU run')
+    parser.add_argument('--cpu-seconds', type=float, default=2.0)
+    parser.add_argument('--json', action='store_true', help='machine-readable output')
+    args = parser.parse_args()
+    client.logger.setLevel('WARNING')
+    
+    results = []
+    for count in (int(n) for n in args.counts.split(',')):
+        pins = BENCH_PINS[:count]
+        cpu, rate, overruns = sampler_cpu(pins, args.interval_ms, args.cpu_seconds)
+        results.append({
+            'pins': count,
+            'bank_idle_ns': round(bank_idle(pins, args.samples), 1),
+            'bank_one_edge_ns': round(bank_busy(pins, args.samples), 1),
+            'per_pin_scan_ns': round(per_pin_idle(pins, args.samples), 1),
+            'sampler_cpu_pct': round(cpu, 2),
+            'samples_per_sec': round(rate, 1),
+            'overruns': overruns
+        })
+    
+    if args.json:
+        print(json.dumps({'benchmark': 'bank', 'interval_ms': args.interval_ms, 'results': results}, indent=2))
+        return
+    print(f"{'pins':>5} {'bank idle ns':>13} {'bank 1-edge ns':>15} {'per-pin scan ns':>16} "
+          f"{'sampler cpu %':>14} {'samples/s':>10}")
+    for r in results:
+        print(f"{r['pins']:>5} {r['bank_idle_ns']:>13} {r['bank_one_edge_ns']:>15} {r['per_pin_scan_ns']:>16} "
+              f"{r['sampler_cpu_pct']:>14} {r['samples_per_sec']:>10}")
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+"""
+Wire encoding benchmark
+Compares encode cost and bytes on the wire of the original per-event JSON
+payload (as built by handle_pin_data before framing) against framed JSON
+batches and the compact bin1 encoding.
+
+Usage: python3 benchmarks/bench_codec.py [--events N] [--batch N] [--json]
+"""
+
+import argparse
+import json
+import os
+import sys
+import time
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..'))
+import andon_protocol
+
+DEVICE_NAME = 'Andon-1'
+
+def make_events(count):
+    """Synthetic edges shaped like the ones the sender thread produces"""
+    now = time.time()
+    formatter = andon_protocol.TimestampFormatter()
+    events = []
+    for i in range(count):
+        event_time = now + i * 0.25
+        events.append({
+            'device_name': DEVICE_NAME,
+            'pin': (23, 24, 25, 12)[i % 4],
+            'state': 'HIGH' if i % 2 else 'LOW',
+            'time_diff_sec': round(4.213 + i % 7, 3),
+            'timestamp': formatter.format(int(event_time * 1000)),
+            'ts_ms': int(event_time * 1000),
+            'seq': i + 1
+        })
+    return events
+
+def encode_original(events):
+    """One JSON object per event, one connection each (the pre-framing protocol)"""
+    total = 0
+    for event in events:
+        data = {
+            'device_name': event['device_name'],
+            'pin': event['pin'],
+            'state': event['state'],
+            'time_diff_sec': round(event['time_diff_sec'], 3),
+            'timestamp': time.strftime('%Y-%m-%d %H:%M:%S')
+        }
+        total += len(json.dumps(data).encode('utf-8'))
+    return total
+
+def encode_framed(encoding, batch_size):
+    def run(events):
+        total = 0
+        for start in range(0, len(events), batch_size):
+            batch = events[start:start + batch_size]
+            payload = andon_protocol.encode_batch(encoding, DEVICE_NAME, batch[0]['seq'], batch)
+            total += andon_protocol.FRAME_HEADER.size + len(payload)
+        return total
+    return run
+
+def measure(name, encoder, events, rounds=5):
+    best = None
+    for _ in range(rounds):
+        start = time.perf_counter()
+        wire_bytes = encoder(events)
+        elapsed = time.perf_counter() - start
+        best = elapsed if best is None else min(best, elapsed)
+    return {
+        'encoding': name,
+        'events': len(events),
+        'encode_ns_per_event': round(best * 1e9 / len(events), 1),
+        'bytes_per_event': round(wire_bytes / len(events), 2)
+    }
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('--events', type=int, default=20000)
+    parser.add_argument('--batch', type=int, default=50, help='events per batch frame')
+    parser.add_argument('--json', action='store_true', help='machine-readable output')
+    args = parser.parse_args()
+    
+    events = make_events(args.events)
+    
+    # Sanity check: bin1 must round-trip everything the benchmark encodes
+    base, decoded = andon_protocol.decode_bin1(andon_protocol.encode_bin1(DEVICE_NAME, 1, events[:10]), DEVICE_NAME)
+    assert [e['seq'] for e in decoded] == [e['seq'] for e in events[:10]]
+    
+    results = [
+        measure('original-json', encode_original, events),
+        measure(f'json-batch{args.batch}', encode_framed('json', args.batch), events),
+        measure('bin1-single', encode_framed('bin1', 1), events),
+        measure(f'bin1-batch{args.batch}', encode_framed('bin1', args.batch), events),
+    ]
+    
+    if args.json:
+        print(json.dumps({'benchmark': 'codec', 'results': results}, indent=2))
+        return
+    
+    print(f"{'encoding':<18}{'ns/event':>12}{'bytes/event':>14}")
+    for result in results:
+        print(f"{result['encoding']:<18}{result['encode_ns_per_event']:>12}{result['bytes_per_event']:>14}")
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+"""
+Collector load generator
+Opens many concurrent framed station sessions against a collector (by
+default a reference server.py started in-process) and reports sustained
+event throughput and ack latency, for sizing the production collector.
+
+Usage: python3 benchmarks/bench_collector.py [--stations N] [--rate EV/S] [--duration S] [--json]
+"""
+
+import argparse
+import asyncio
+import json
+import random
+import resource
+import time
+
+from bench_common import percentile
+import andon_protocol
+import server
+
+async def read_frame(reader):
+    header = await reader.readexactly(andon_protocol.FRAME_HEADER.size)
+    (length,) = andon_protocol.FRAME_HEADER.unpack(header)
+    return await reader.readexactly(length)
+
+def write_frame(writer, payload):
+    writer.write(andon_protocol.FRAME_HEADER.pack(len(payload)) + payload)
+
+async def station(index, args, deadline, latencies, counters):
+    """One simulated station sending Poisson-distributed edges in small batches"""
+    name = f"bench-{index:05d}"
+    reader, writer = await asyncio.open_connection(args.host, args.port)
+    hello = {'type': 'hello', 'device_name': name, 'protocol': andon_protocol.PROTOCOL_VERSION,
+             'encodings': [args.encoding]}
+    write_frame(writer, json.dumps(hello).encode('utf-8'))
+    welcome = json.loads(await read_frame(reader))
+    seq = welcome.get('ack', 0)
+    
+    pending = {}
+    
+    async def ack_reader():
+        while True:
+            ack = json.loads(await read_frame(reader))
+            now = time.perf_counter()
+            for acked in [s for s in pending if s <= ack['ack']]:
+                latencies.append(now - pending.pop(acked))
+                counters['acked'] += args.batch
+    
+    reader_task = asyncio.create_task(ack_reader())
+    try:
+        # Spread session start-up so the first batches don't all land at once
+        await asyncio.sleep(random.random() * args.batch / args.rate)
+        while time.monotonic() < deadline:
+            await asyncio.sleep(random.expovariate(args.rate / args.batch))
+            now_ms = int(time.time() * 1000)
+            events = []
+            for _ in range(args.batch):
+                seq += 1
+                events.append({'device_name': name, 'pin': 23, 'state': 'LOW' if seq % 2 else 'HIGH',
+                               'time_diff_sec': 1.5, 'timestamp': '', 'ts_ms': now_ms, 'seq': seq})
+            pending[seq] = time.perf_counter()
+            write_frame(writer, andon_protocol.encode_batch(args.encoding, name, events[0]['seq'], events))
+            counters['sent'] += args.batch
+            await writer.drain()
+        
+        # Let outstanding acks arrive
+        grace = time.monotonic() + 5
+        while pending and time.monotonic() < grace:
+            await asyncio.sleep(0.05)
+    finally:
+        reader_task.cancel()
+        writer.close()
+
+async def run(args):
+    collector = None
+    if args.port == 0:
+        collector = server.Collector(server.EventSink(None), stats_interval=3600)
+        srv = await asyncio.start_server(collector.handle_connection, '127.0.0.1', 0, backlog=4096)
+        args.host, args.port = srv.sockets[0].getsockname()[:2]
+    
+    latencies = []
+    counters = {'sent': 0, 'acked': 0}
+    usage_before = resource.getrusage(resource.RUSAGE_SELF)
+    start = time.monotonic()
+    deadline = start + args.duration
+    
+    # Open sessions in waves to stay under the listen backlog
+    tasks = []
+    for index in range(args.stations):
+        tasks.append(asyncio.create_task(station(index, args, deadline, latencies, counters)))
+        if index % 200 == 199:
+            await asyncio.sleep(0.05)
+    results = await asyncio.gather(*tasks, return_exceptions=True)
+    elapsed = time.monotonic() - start
+    usage_after = resource.getrusage(resource.RUSAGE_SELF)
+    
+    failures = [r for r in results if isinstance(r, Exception)]
+    latencies.sort()
+    cpu = (usage_after.ru_utime + usage_after.ru_stime) - (usage_before.ru_utime + usage_before.ru_stime)
+    return {
+        'benchmark': 'collector',
+        'stations': args.stations,
+        'failed_stations': len(failures),
+        'encoding': args.encoding,
+        'batch': args.batch,
+        'offered_rate_per_station': args.rate,
+        'duration_s': round(elapsed, 2),
+        'events_sent': counters['sent'],
+        'events_acked': counters['acked'],
+        'throughput_eps': round(counters['acked'] / elapsed, 1),
+        'ack_latency_ms': {
+            'p50': round(percentile(latencies, 0.50) * 1000, 3),
+            'p99': round(percentile(latencies, 0.99) * 1000, 3),
+            'p999': round(percentile(latencies, 0.999) * 1000, 3),
+        },
+        # Generator and in-process collector share this process unless --port was given
+        'cpu_us_per_event': round(cpu * 1e6 / counters['acked'], 2) if counters['acked'] else None,
+        'in_process_collector': collector is not None
+    }
+
+def main():
+    parser = argparse.ArgumentParser(description="Collector load generator")
+    parser.add_argument('--host', default='127.0.0.1')
+    parser.add_argument('--port', type=int, default=0, help='collector port (0 = start one in-process)')
+    parser.add_argument('--stations', type=int, default=1000)
+    parser.add_argument('--rate', type=float, default=2.0, help='events per second per station')
+    parser.add_argument('--batch', type=int, default=1, help='events per frame')
+    parser.add_argument('--encoding', choices=andon_protocol.SUPPORTED_ENCODINGS, default='bin1')
+    parser.add_argument('--duration', type=float, default=10.0)
+    parser.add_argument('--json', action='store_true', help='machine-readable output')
+    args = parser.parse_args()
+    
+    server.raise_file_limit()
+    result = asyncio.run(run(args))
+    
+    if args.json:
+        print(json.dumps(result, indent=2))
+    else:
+        for key, value in result.items():
+            print(f"{key:<28}{value}")
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,64 @@
+"""
+Helpers shared by the benchmark scripts
+Imported from a script in this directory; puts the repository root on the
+import path so client and server resolve to the working tree.
+"""
+
+import asyncio
+import configparser
+import os
+import sys
+import tempfile
+import threading
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..'))
+import client
+import server
+
+# BCM pins usable for inputs on a 40-pin header, in the order they are assigned
+BENCH_PINS = [23, 24, 25, 12, 5, 6, 13, 16, 17, 18, 19, 20, 21, 22, 26, 27, 4, 7, 8, 9, 10, 11, 14, 15, 2, 3]
+
+def percentile(sorted_values, fraction):
+    if not sorted_values:
+        return 0.0
+    return sorted_values[min(len(sorted_values) - 1, int(fraction * len(sorted_values)))]
+
+def start_collector():
+    """Run a reference collector on an ephemeral port in a background thread"""
+    collector = server.Collector(server.EventSink(None), stats_interval=3600)
+    ready = threading.Event()
+    address = {}
+    
+    def run():
+        async def serve():
+            srv = await asyncio.start_server(collector.handle_connection, '127.0.0.1', 0)
+            address['port'] = srv.sockets[0].getsockname()[1]
+            ready.set()
+            async with srv:
+                await srv.serve_forever()
+        asyncio.run(serve())
+    
+    threading.Thread(target=run, name='collector', daemon=True).start()
+    ready.wait()
+    return collector, address['port']
+
+def make_monitor(sections, prefix='andon-bench-'):
+    """GPIOMonitor whose config, sequence file and journal live in a fresh
+    temp directory.
+
+    sections is {section: {option: value}} applied over bench defaults: no
+    periodic stats and no network checks, so the monitor never tries to
+    repair the host's network.
+    """
+    workdir = tempfile.mkdtemp(prefix=prefix)
+    config = configparser.ConfigParser()
+    config.read_dict({
+        'sender': {'stats_interval': 0, 'sequence_file': os.path.join(workdir, 'sequence')},
+        'journal': {'path': os.path.join(workdir, 'journal')},
+        'network': {'check_interval': 3600, 'gateway_check': 'false'}
+    })
+    config.read_dict(sections)
+    config_file = os.path.join(workdir, 'gpio_monitor.conf')
+    with open(config_file, 'w') as f:
+        config.write(f)
+    return client.GPIOMonitor(config_file)
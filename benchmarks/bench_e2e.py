@@ -0,0 +1,171 @@
+#!/usr/bin/env python3
+"""
+End-to-end edge-to-ack latency benchmark
+Drives GPIOMonitor through gpiozero's mock pin factory against a local
+reference collector and measures the time from a pin edge to the
+collector's acknowledgement of that event, plus throughput and CPU cost.
+
+Usage: python3 benchmarks/bench_e2e.py [--pins N] [--rate EDGES/S] [--duration S] [--json]
+"""
+
+import argparse
+import collections
+import json
+import logging
+import random
+import resource
+import threading
+import time
+
+from gpiozero import Device
+from gpiozero.pins.mock import MockFactory
+from bench_common import BENCH_PINS, make_monitor, percentile, start_collector
+import client
+
+def monitor_config(args, host, port):
+    return {
+        'device': {'name': 'bench-station'},
+        'server': {'ip': host, 'port': port, 'protocol': args.protocol, 'encoding': args.encoding},
+        'gpio': {'pins': ','.join(str(pin) for pin in BENCH_PINS[:args.pins]), 'debounce_time': 0},
+        'sender': {'linger_ms': args.linger_ms, 'max_batch': args.max_batch, 'window': args.window},
+        'chatter': {'enabled': 'false'}
+    }
+
+def run(args):
+    Device.pin_factory = MockFactory()
+    client.logger.setLevel(getattr(logging, args.log_level))
+    
+    if args.port:
+        collector, host, port = None, args.host, args.port
+    else:
+        collector, port = start_collector()
+        host = '127.0.0.1'
+    
+    monitor = make_monitor(monitor_config(args, host, port))
+    
+    # Edge times per pin; events for one pin are acknowledged in edge order
+    edge_times = collections.defaultdict(collections.deque)
+    latencies = []
+    lock = threading.Lock()
+    
+    def on_acked(events):
+        now = time.perf_counter()
+        with lock:
+            for event in events:
+                pending = edge_times.get(event['pin'])
+                if pending:
+                    latencies.append(now - pending.popleft())
+    
+    monitor.channel.ack_listeners.append(on_acked)
+    
+    deadline = time.monotonic() + 10
+    while not monitor.network_manager.is_connected and time.monotonic() < deadline:
+        time.sleep(0.05)
+    if not monitor.network_manager.is_connected:
+        raise SystemExit("Monitor never reported connectivity to the collector")
+    
+    pins = [Device.pin_factory.pin(pin) for pin in monitor.pins]
+    levels = [True] * len(pins)
+    usage_before = resource.getrusage(resource.RUSAGE_SELF)
+    start = time.perf_counter()
+    next_edge = start
+    edges = 0
+    
+    # Poisson arrivals across all pins, scheduled against the perf counter
+    while next_edge - start < args.duration:
+        # Sleep most of the gap, spin only for the last fraction of a millisecond
+        gap = next_edge - time.perf_counter()
+        if gap > 0.001:
+            time.sleep(gap - 0.0005)
+        while time.perf_counter() < next_edge:
+            pass
+        index = random.randrange(len(pins))
+        with lock:
+            edge_times[monitor.pins[index]].append(time.perf_counter())
+        if levels[index]:
+            pins[index].drive_low()
+        else:
+            pins[index].drive_high()
+        levels[index] = not levels[index]
+        edges += 1
+        next_edge += random.expovariate(args.rate)
+    
+    drive_elapsed = time.perf_counter() - start
+    
+    # Wait for outstanding acknowledgements
+    deadline = time.monotonic() + args.drain_timeout
+    while time.monotonic() < deadline:
+        with lock:
+            if len(latencies) >= edges:
+                break
+        time.sleep(0.01)
+    elapsed = time.perf_counter() - start
+    usage_after = resource.getrusage(resource.RUSAGE_SELF)
+    
+    stats = monitor.get_stats()
+    monitor.cleanup()
+    
+    latencies.sort()
+    acked = len(latencies)
+    cpu = (usage_after.ru_utime + usage_after.ru_stime) - (usage_before.ru_utime + usage_before.ru_stime)
+    return {
+        'benchmark': 'e2e',
+        'timestamp': time.strftime('%Y-%m-%dT%H:%M:%S%z'),
+        'params': {
+            'pins': args.pins,
+            'rate': args.rate,
+            'duration': args.duration,
+            'protocol': args.protocol,
+            'encoding': args.encoding,
+            'linger_ms': args.linger_ms,
+            'max_batch': args.max_batch,
+            'window': args.window,
+            'in_process_collector': collector is not None
+        },
+        'edges': edges,
+        'acked': acked,
+        'lost': edges - acked,
+        'offered_rate_eps': round(edges / drive_elapsed, 1),
+        'throughput_eps': round(acked / elapsed, 1),
+        'latency_ms': {
+            'p50': round(percentile(latencies, 0.50) * 1000, 3),
+            'p99': round(percentile(latencies, 0.99) * 1000, 3),
+            'p999': round(percentile(latencies, 0.999) * 1000, 3),
+            'max': round(latencies[-1] * 1000, 3) if latencies else 0.0
+        },
+        # Process-wide: includes the edge driver (and the collector unless --port is given)
+        'cpu_us_per_event': round(cpu * 1e6 / acked, 2) if acked else None,
+        'pipeline': stats
+    }
+
+def main():
+    parser = argparse.ArgumentParser(description="End-to-end edge-to-ack latency benchmark")
+    parser.add_argument('--pins', type=int, default=4, choices=range(1, len(BENCH_PINS) + 1), metavar='N')
+    parser.add_argument('--rate', type=float, default=100.0, help='total edges per second (Poisson)')
+    parser.add_argument('--duration', type=float, default=10.0, help='seconds of edge injection')
+    parser.add_argument('--drain-timeout', type=float, default=10.0)
+    parser.add_argument('--host', default='127.0.0.1')
+    parser.add_argument('--port', type=int, default=0, help='external collector port (0 = in-process)')
+    parser.add_argument('--protocol', choices=('framed', 'legacy'), default='framed')
+    parser.add_argument('--encoding', choices=('bin1', 'json'), default='bin1')
+    parser.add_argument('--linger-ms', type=float, default=5)
+    parser.add_argument('--max-batch', type=int, default=50)
+    parser.add_argument('--window', type=int, default=1000)
+    parser.add_argument('--log-level', default='WARNING', choices=('DEBUG', 'INFO', 'WARNING', 'ERROR'))
+    parser.add_argument('--output', help='also write the JSON result to this file')
+    parser.add_argument('--json', action='store_true', help='machine-readable output on stdout')
+    args = parser.parse_args()
+    
+    result = run(args)
+    
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump(result, f, indent=2)
+    if args.json:
+        print(json.dumps(result, indent=2))
+    else:
+        for key in ('edges', 'acked', 'lost', 'offered_rate_eps', 'throughput_eps', 'latency_ms', 'cpu_us_per_event'):
+            print(f"{key:<20}{result[key]}")
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,269 @@
+#!/usr/bin/env python3
+"""
+Dual-uplink failover benchmark
+Builds a station and a collector network namespace joined by two veth
+pairs standing in for Ethernet and Wi-Fi, runs the reference collector in
+one and GPIOMonitor with both uplinks in the other, then takes the
+preferred link away mid-stream. Reports how long acknowledgements stalled,
+whether any event was lost or written twice, and whether traffic moved
+back once the link returned.
+
+Needs root (ip netns, veth pairs).
+Usage: sudo python3 benchmarks/bench_failover.py [--rate EDGES/S] [--mode down|carrier] [--json]
+"""
+
+import argparse
+import collections
+import json
+import logging
+import os
+import signal
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+BENCH_DIR = os.path.dirname(os.path.abspath(__file__))
+
+STATION_NS = 'andon-st'
+COLLECTOR_NS = 'andon-col'
+COLLECTOR_IP = '10.31.0.1'
+COLLECTOR_PORT = 5000
+# (station interface, collector interface, subnet prefix, route metric), in order of preference
+UPLINKS = [('st-eth', 'col-eth', '10.31.1', 100), ('st-wlan', 'col-wlan', '10.31.2', 600)]
+
+def ip(*args, netns=None):
+    command = ['ip'] + (['netns', 'exec', netns, 'ip'] if netns else []) + list(args)
+    subprocess.run(command, check=True)
+
+def setup_namespaces():
+    for ns in (STATION_NS, COLLECTOR_NS):
+        subprocess.run(['ip', 'netns', 'del', ns], stderr=subprocess.DEVNULL)
+        ip('netns', 'add', ns)
+        ip('link', 'set', 'lo', 'up', netns=ns)
+    ip('addr', 'add', f'{COLLECTOR_IP}/32', 'dev', 'lo', netns=COLLECTOR_NS)
+    for station_if, collector_if, prefix, metric in UPLINKS:
+        ip('link', 'add', station_if, 'netns', STATION_NS, 'type', 'veth', 'peer', 'name', collector_if,
+           'netns', COLLECTOR_NS)
+        ip('addr', 'add', f'{prefix}.1/24', 'dev', station_if, netns=STATION_NS)
+        ip('addr', 'add', f'{prefix}.2/24', 'dev', collector_if, netns=COLLECTOR_NS)
+        ip('link', 'set', station_if, 'up', netns=STATION_NS)
+        ip('link', 'set', collector_if, 'up', netns=COLLECTOR_NS)
+        ip('route', 'add', 'default', 'via', f'{prefix}.2', 'dev', station_if, 'metric', str(metric),
+           netns=STATION_NS)
+
+def teardown_namespaces():
+    for ns in (STATION_NS, COLLECTOR_NS):
+        subprocess.run(['ip', 'netns', 'del', ns], stderr=subprocess.DEVNULL)
+
+def station_config():
+    station_ifs = [uplink[0] for uplink in UPLINKS]
+    return {
+        'device': {'name': 'failover-station'},
+        'server': {'ip': COLLECTOR_IP, 'port': COLLECTOR_PORT},
+        'gpio': {'pins': 23, 'debounce_time': 0},
+        'sender': {'window': 1000},
+        'chatter': {'enabled': 'false'},
+        'network': {'ethernet_interface': station_ifs[0], 'wifi_interface': station_ifs[1],
+                    'uplinks': ','.join(station_ifs), 'link_monitor': 'netlink'}
+    }
+
+def cut_uplink(args, restore=False):
+    """Take the preferred uplink away (or give it back) the way --mode says"""
+    station_if, collector_if, prefix, metric = UPLINKS[0]
+    state = 'up' if restore else 'down'
+    if args.mode == 'down':
+        ip('link', 'set', station_if, state)
+    else:
+        # Unplugging the far end: the station only sees its carrier drop
+        ip('link', 'set', collector_if, state, netns=COLLECTOR_NS)
+    if restore:
+        subprocess.run(['ip', 'route', 'replace', 'default', 'via', f'{prefix}.2', 'dev', station_if,
+                        'metric', str(metric)], check=True)
+
+def run_station(args):
+    """Runs inside the station namespace; prints the measurements as JSON"""
+    from gpiozero import Device
+    from gpiozero.pins.mock import MockFactory
+    from bench_common import make_monitor, percentile
+    import client
+    
+    Device.pin_factory = MockFactory()
+    client.logger.setLevel(getattr(logging, args.log_level))
+    monitor = make_monitor(station_config(), prefix='andon-failover-')
+    multipath = monitor.multipaths[0]
+    
+    edge_times = collections.deque()
+    ack_times = []
+    latencies = []
+    lock = threading.Lock()
+    
+    def on_acked(events):
+        now = time.perf_counter()
+        with lock:
+            for event in events:
+                ack_times.append(now)
+                if edge_times:
+                    latencies.append((edge_times[0], now - edge_times.popleft()))
+    
+    monitor.channel.ack_listeners.append(on_acked)
+    
+    # Wait for both uplinks to carry an open session
+    deadline = time.monotonic() + 15
+    while time.monotonic() < deadline:
+        if monitor.network_manager.is_connected and multipath.get_stats()['paths_open'] == len(UPLINKS):
+            break
+        time.sleep(0.05)
+    else:
+        raise SystemExit(f"Uplinks never came up: {multipath.get_stats()}")
+    
+    pin = Device.pin_factory.pin(monitor.pins[0])
+    level = True
+    edges = 0
+    interval = 1.0 / args.rate
+    start = time.perf_counter()
+    cut_at = start + args.warmup
+    restore_at = cut_at + args.hold
+    stop_at = restore_at + args.tail
+    t_cut = t_restore = None
+    next_edge = start
+    
+    while next_edge < stop_at:
+        gap = next_edge - time.perf_counter()
+        if gap > 0:
+            time.sleep(gap)
+        now = time.perf_counter()
+        if t_cut is None and now >= cut_at:
+            t_cut = time.perf_counter()
+            cut_uplink(args)
+        elif t_restore is None and now >= restore_at:
+            t_restore = time.perf_counter()
+            cut_uplink(args, restore=True)
+        with lock:
+            edge_times.append(time.perf_counter())
+        if level:
+            pin.drive_low()
+        else:
+            pin.drive_high()
+        level = not level
+        edges += 1
+        next_edge += interval
+    
+    # Wait for outstanding acknowledgements and for traffic to move back
+    deadline = time.monotonic() + args.drain_timeout
+    while time.monotonic() < deadline:
+        with lock:
+            drained = len(ack_times) >= edges
+        if drained and multipath.active is multipath.paths[0]:
+            break
+        time.sleep(0.01)
+    failed_back = multipath.active is multipath.paths[0]
+    stats = monitor.get_stats()
+    network = monitor.network_manager.metrics.snapshot()
+    monitor.cleanup()
+    
+    with lock:
+        after_cut = [t for t in ack_times if t >= t_cut]
+        around_cut = [latency for edge, latency in latencies if t_cut - 0.5 <= edge < t_cut + 0.5]
+        steady = sorted(latency for edge, latency in latencies if edge < t_cut)
+        # Longest silence between acknowledgements once the link was gone
+        window = [t_cut] + [t for t in ack_times if t_cut <= t < t_restore]
+        stall = max((b - a for a, b in zip(window, window[1:])), default=0.0)
+        acked = len(ack_times)
+    
+    return {
+        'edges': edges,
+        'acked': acked,
+        'lost': edges - acked,
+        'first_ack_after_cut_ms': round((after_cut[0] - t_cut) * 1000, 3) if after_cut else None,
+        'max_ack_gap_ms': round(stall * 1000, 3),
+        'steady_p50_ms': round(percentile(steady, 0.50) * 1000, 3) if steady else None,
+        'max_latency_around_cut_ms': round(max(around_cut) * 1000, 3) if around_cut else None,
+        'failed_back': failed_back,
+        'pipeline': stats,
+        'network': network
+    }
+
+def count_collected(path):
+    """Distinct and total pin events the collector wrote"""
+    seqs = []
+    with open(path) as f:
+        for line in f:
+            event = json.loads(line)
+            if event.get('state') in ('HIGH', 'LOW'):
+                seqs.append(event['seq'])
+    return len(set(seqs)), len(seqs)
+
+def run(args):
+    if os.geteuid() != 0:
+        raise SystemExit("Needs root to create network namespaces")
+    workdir = tempfile.mkdtemp(prefix='andon-failover-')
+    output = os.path.join(workdir, 'collected.jsonl')
+    setup_namespaces()
+    collector = None
+    try:
+        collector = subprocess.Popen(['ip', 'netns', 'exec', COLLECTOR_NS, sys.executable,
+                                      os.path.join(BENCH_DIR, '..', 'server.py'), '--host', COLLECTOR_IP,
+                                      '--port', str(COLLECTOR_PORT), '--output', output,
+                                      '--stats-interval', '3600'],
+                                     stderr=subprocess.DEVNULL)
+        time.sleep(1)
+        station = subprocess.run(['ip', 'netns', 'exec', STATION_NS, sys.executable, os.path.abspath(__file__),
+                                  '--station', '--rate', str(args.rate), '--mode', args.mode,
+                                  '--warmup', str(args.warmup), '--hold', str(args.hold), '--tail', str(args.tail),
+                                  '--drain-timeout', str(args.drain_timeout), '--log-level', args.log_level],
+                                 stdout=subprocess.PIPE, text=True)
+        if station.returncode != 0:
+            raise SystemExit(f"Station run failed ({station.returncode})")
+        # The client logs to stdout too; the result is the last line
+        result = json.loads(station.stdout.strip().splitlines()[-1])
+    finally:
+        if collector:
+            collector.send_signal(signal.SIGTERM)
+            collector.wait(10)
+        teardown_namespaces()
+    
+    distinct, written = count_collected(output)
+    result.update({
+        'benchmark': 'failover',
+        'timestamp': time.strftime('%Y-%m-%dT%H:%M:%S%z'),
+        'params': {'rate': args.rate, 'mode': args.mode, 'warmup': args.warmup, 'hold': args.hold},
+        'collected': distinct,
+        'duplicates_written': written - distinct
+    })
+    return result
+
+def main():
+    parser = argparse.ArgumentParser(description="Dual-uplink failover benchmark")
+    parser.add_argument('--rate', type=float, default=200.0, help='edges per second, evenly spaced')
+    parser.add_argument('--mode', choices=('down', 'carrier'), default='down',
+                        help="'down': set the station's preferred interface down; 'carrier': unplug its far end")
+    parser.add_argument('--warmup', type=float, default=1.0, help='seconds before the uplink is cut')
+    parser.add_argument('--hold', type=float, default=2.0, help='seconds the uplink stays cut')
+    parser.add_argument('--tail', type=float, default=1.0, help='seconds of edges after it returns')
+    parser.add_argument('--drain-timeout', type=float, default=15.0)
+    parser.add_argument('--log-level', default='WARNING', choices=('DEBUG', 'INFO', 'WARNING', 'ERROR'))
+    parser.add_argument('--station', action='store_true', help=argparse.SUPPRESS)
+    parser.add_argument('--output', help='also write the JSON result to this file')
+    parser.add_argument('--json', action='store_true', help='machine-readable output on stdout')
+    args = parser.parse_args()
+    
+    if args.station:
+        print(json.dumps(run_station(args)))
+        return
+    
+    result = run(args)
+    
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump(result, f, indent=2)
+    if args.json:
+        print(json.dumps(result, indent=2))
+    else:
+        for key in ('edges', 'acked', 'lost', 'collected', 'duplicates_written', 'first_ack_after_cut_ms',
+                    'max_ack_gap_ms', 'steady_p50_ms', 'max_latency_around_cut_ms', 'failed_back'):
+            print(f"{key:<28}{result[key]}")
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""
+Maximum sustainable event rate
+Drives the full GPIOMonitor pipeline (capture callback, sender queue,
+batching, acknowledged delivery) from a synthetic or recorded edge trace
+against an in-process reference collector. The trace is replayed at
+increasing speed factors until events are lost or acknowledgements fall
+behind; the highest rate that kept up is reported. Runs without GPIO
+hardware or gpiozero.
+
+Usage: python3 benchmarks/bench_replay.py [--trace FILE | --pins N --rate EV/S] [--json]
+"""
+
+import argparse
+import json
+import logging
+import time
+
+from bench_common import BENCH_PINS, make_monitor, start_collector
+import client
+
+def trace_pins(path):
+    """Pins named in a recorded trace's levels header"""
+    with open(path) as f:
+        f.readline()
+        header = f.readline().split()
+    if header[:2] != ['#', 'levels']:
+        raise SystemExit(f"{path} has no levels header")
+    return [int(item.split('=')[0]) for item in header[2:]]
+
+def run_step(args, port, speed):
+    """Replay the whole trace once at the given speed; returns the step's results"""
+    pins = trace_pins(args.trace) if args.trace else BENCH_PINS[:args.pins]
+    acked = [0]
+    
+    def on_acked(events):
+        acked[0] += len(events)
+    
+    monitor = make_monitor({
+        'server': {'ip': '127.0.0.1', 'port': port, 'encoding': args.encoding},
+        'gpio': {'pins': ','.join(str(pin) for pin in pins),
+                 'backend': 'replay' if args.trace else 'synthetic', 'debounce_time': 0},
+        # Held back until the session is up, so only steady state is measured
+        'simulation': {'trace': args.trace or '', 'speed': speed, 'profile': args.profile,
+                       'rate': args.rate / args.pins, 'duration': args.duration, 'seed': args.seed,
+                       'autostart': 'false'},
+        'sender': {'queue_size': args.queue_size},
+        'chatter': {'enabled': 'false'}
+    }, prefix='andon-replay-')
+    monitor.channel.ack_listeners.append(on_acked)
+    
+    deadline = time.monotonic() + 10
+    while not monitor.network_manager.is_connected and time.monotonic() < deadline:
+        time.sleep(0.05)
+    
+    start = time.perf_counter()
+    monitor.source.release()
+    monitor.source.finished.wait()
+    emit_elapsed = time.perf_counter() - start
+    
+    # Give the pipeline a bounded amount of time to catch up
+    emitted = monitor.source.emitted
+    deadline = time.monotonic() + max(1.0, emit_elapsed * 0.1)
+    while acked[0] < emitted - monitor.pipeline.dropped and time.monotonic() < deadline:
+        time.sleep(0.005)
+    elapsed = time.perf_counter() - start
+    
+    stats = monitor.get_stats()
+    monitor.running = False
+    monitor.cleanup()
+    
+    return {
+        'speed': speed,
+        'edges': emitted,
+        'acked': acked[0],
+        'dropped': stats['dropped'],
+        'offered_eps': round(emitted / emit_elapsed, 1) if emit_elapsed else None,
+        'throughput_eps': round(acked[0] / elapsed, 1),
+        'sustained': emitted > 0 and acked[0] == emitted and elapsed <= emit_elapsed * 1.1 + 0.05
+    }
+
+def main():
+    parser = argparse.ArgumentParser(description="Maximum sustainable event rate")
+    parser.add_argument('--trace', help='edge trace recorded with [gpio] record_trace (default: synthetic)')
+    parser.add_argument('--pins', type=int, default=4, help='synthetic pins (a trace brings its own)')
+    parser.add_argument('--rate', type=float, default=50.0, help='synthetic edges per second (all pins, at 1x)')
+    parser.add_argument('--profile', choices=client.SyntheticEdgeSource.PROFILES, default='poisson')
+    parser.add_argument('--duration', type=float, default=20.0, help='synthetic trace length in seconds (at 1x)')
+    parser.add_argument('--seed', default='1')
+    parser.add_argument('--speeds', default='1,2,4,8,16,32,64,128,256', help='speed factors to try in order')
+    parser.add_argument('--queue-size', type=int, default=1000)
+    parser.add_argument('--encoding', choices=('bin1', 'json'), default='bin1')
+    parser.add_argument('--json', action='store_true', help='machine-readable output')
+    args = parser.parse_args()
+    
+    client.logger.setLevel(logging.WARNING)
+    collector, port = start_collector()
+    
+    steps = []
+    for speed in (float(s) for s in args.speeds.split(',')):
+        step = run_step(args, port, speed)
+        steps.append(step)
+        if not args.json:
+            print(f"speed {speed:>6}x  offered {step['offered_eps']:>10} ev/s  "
+                  f"acked {step['throughput_eps']:>10} ev/s  dropped {step['dropped']:>6}  "
+                  f"{'ok' if step['sustained'] else 'FELL BEHIND'}")
+        if not step['sustained']:
+            break
+    
+    sustained = [step for step in steps if step['sustained']]
+    result = {
+        'benchmark': 'replay',
+        'source': args.trace or f"synthetic:{args.profile}",
+        'pins': len(trace_pins(args.trace)) if args.trace else args.pins,
+        'steps': steps,
+        'max_sustainable_eps': max((step['offered_eps'] for step in sustained), default=0.0)
+    }
+    if args.json:
+        print(json.dumps(result, indent=2))
+    else:
+        print(f"max sustainable rate: {result['max_sustainable_eps']} events/s")
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+"""
+Local event ring throughput and latency
+A producer process publishes edges into the shared-memory ring the way
+GPIOMonitor does, while reader processes follow it with andon_ring's
+RingReader. Latency is measured from the edge's CLOCK_MONOTONIC timestamp
+to the moment a reader holds the event, which is comparable across
+processes. A second, unpaced run reports the producer's peak rate.
+
+Usage: python3 benchmarks/bench_ring.py [--rate 2000] [--duration 5] [--readers 2] [--json]
+"""
+
+import argparse
+import json
+import multiprocessing
+import os
+import tempfile
+import time
+
+from bench_common import BENCH_PINS, percentile
+import andon_ring
+
+def reader_process(path, count, ready, results):
+    reader = andon_ring.RingReader(path)
+    ready.set()
+    latencies = []
+    received = 0
+    deadline = time.monotonic() + 60
+    while received < count and time.monotonic() < deadline:
+        events = reader.wait(timeout=1.0, interval=0.0001)
+        now_ns = time.monotonic_ns()
+        for event in events:
+            latencies.append(now_ns - event.timestamp_ns)
+        received += len(events)
+    results.put({'received': received, 'lost': reader.lost, 'latencies': latencies})
+
+def publish(writer, count, rate):
+    """Publish count edges at rate per second (0 = as fast as possible)"""
+    gap_ns = int(1e9 / rate) if rate else 0
+    start_ns = time.monotonic_ns()
+    for i in range(count):
+        if gap_ns:
+            due_ns = start_ns + i * gap_ns
+            while time.monotonic_ns() < due_ns:
+                if due_ns - time.monotonic_ns() > 200_000:
+                    time.sleep(0.0001)
+        now_ns = time.monotonic_ns()
+        writer.publish(BENCH_PINS[i % len(BENCH_PINS)], i & 1, 250, time.time_ns() // 1_000_000, now_ns)
+    return (time.monotonic_ns() - start_ns) / 1e9
+
+def run(path, args, rate, count):
+    writer = andon_ring.RingWriter(path, args.slots)
+    results = multiprocessing.Queue()
+    readers = []
+    for _ in range(args.readers):
+        ready = multiprocessing.Event()
+        process = multiprocessing.Process(target=reader_process, args=(path, count, ready, results))
+        process.start()
+        ready.wait()
+        readers.append(process)
+    
+    elapsed = publish(writer, count, rate)
+    outcomes = [results.get() for _ in readers]
+    for process in readers:
+        process.join()
+    writer.close()
+    
+    latencies = sorted(latency for outcome in outcomes for latency in outcome['latencies'])
+    return {
+        'events': count,
+        'publish_rate_eps': round(count / elapsed, 1),
+        'received': [outcome['received'] for outcome in outcomes],
+        'lost': [outcome['lost'] for outcome in outcomes],
+        'latency_us': {name: round(percentile(latencies, fraction) / 1000, 1) if latencies else None
+                       for name, fraction in (('p50', 0.5), ('p99', 0.99), ('p999', 0.999))}
+    }
+
+def main():
+    parser = argparse.ArgumentParser(description="Local event ring throughput and latency")
+    parser.add_argument('--rate', type=float, default=2000.0, help='paced edges per second')
+    parser.add_argument('--duration', type=float, default=5.0, help='seconds of paced publishing')
+    parser.add_argument('--burst', type=int, default=200000, help='events in the unpaced run')
+    parser.add_argument('--readers', type=int, default=2)
+    parser.add_argument('--slots', type=int, default=4096)
+    parser.add_argument('--json', action='store_true', help='machine-readable output')
+    args = parser.parse_args()
+    
+    directory = '/dev/shm' if os.path.isdir('/dev/shm') else tempfile.gettempdir()
+    path = os.path.join(directory, f"andon_ring_bench.{os.getpid()}")
+    try:
+        paced = run(path, args, args.rate, int(args.rate * args.duration))
+        burst = run(path, args, 0, args.burst)
+    finally:
+        if os.path.exists(path):
+            os.unlink(path)
+    
+    result = {'benchmark': 'ring', 'readers': args.readers, 'slots': args.slots, 'paced': paced, 'burst': burst}
+    if args.json:
+        print(json.dumps(result, indent=2))
+        return
+    for name, run_result in (('paced', paced), ('burst', burst)):
+        print(f"{name:>6}: {run_result['events']} events at {run_result['publish_rate_eps']} ev/s, "
+              f"received {run_result['received']}, lost {run_result['lost']}, "
+              f"latency us {run_result['latency_us']}")
+
+if __name__ == "__main__":
+    main()
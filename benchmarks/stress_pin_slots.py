@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+"""
+Pin state stress test
+Hammers GPIOMonitor.record_edge from one writer thread per pin while reader
+threads continuously snapshot every pin, with the interpreter's thread
+switch interval cut to a microsecond so updates are interrupted as often as
+possible. Fails if any snapshot is torn (a level, timestamp and edge count
+that were never stored together), or if any edge or duration is lost.
+Runs without GPIO hardware: capture uses the simulated gpiod backend.
+
+Usage: python3 benchmarks/stress_pin_slots.py [--pins 26] [--edges 20000] [--readers 4]
+"""
+
+import argparse
+import logging
+import socket
+import sys
+import threading
+import time
+
+from bench_common import BENCH_PINS, make_monitor
+import client
+
+def main():
+    parser = argparse.ArgumentParser(description="Pin state stress test")
+    parser.add_argument('--pins', type=int, default=len(BENCH_PINS))
+    parser.add_argument('--edges', type=int, default=20000, help='edges per pin')
+    parser.add_argument('--readers', type=int, default=4)
+    args = parser.parse_args()
+    
+    client.logger.setLevel(logging.WARNING)
+    pins = BENCH_PINS[:args.pins]
+    # Nothing is ever sent (submit is replaced), but the server check needs a port that answers
+    listener = socket.socket()
+    listener.bind(('127.0.0.1', 0))
+    listener.listen()
+    monitor = make_monitor({
+        'server': {'ip': '127.0.0.1', 'port': listener.getsockname()[1], 'protocol': 'legacy'},
+        'gpio': {'pins': ','.join(str(pin) for pin in pins), 'backend': 'simulated'}
+    }, prefix='andon-stress-')
+    
+    # Collect what record_edge hands to the sender thread instead of sending it
+    submitted = {pin: [] for pin in pins}
+    monitor.pipeline.submit = lambda event: submitted[event['pin']].append(event) or True
+    
+    # Each pin gets its own step so a snapshot mixing two updates is detectable:
+    # after n edges a pin must be at start + n * step with level initial ^ (n odd)
+    initial = {pin: monitor.pin_slots[pin].snapshot() for pin in pins}
+    steps = {pin: 1_000_000 + 7919 * index for index, pin in enumerate(pins)}
+    
+    torn = [0]
+    snapshots = [0]
+    done = threading.Event()
+    start_barrier = threading.Barrier(len(pins) + args.readers + 1)
+    
+    def writer(pin):
+        level, since_ns, _ = initial[pin]
+        start_barrier.wait()
+        for n in range(1, args.edges + 1):
+            level = not level
+            monitor.record_edge(pin, level, since_ns + n * steps[pin])
+    
+    def reader():
+        start_barrier.wait()
+        while not done.is_set():
+            for pin in pins:
+                level, since_ns, edges = monitor.pin_slots[pin].snapshot()
+                level0, since0_ns, _ = initial[pin]
+                if since_ns != since0_ns + edges * steps[pin] or level != (level0 ^ bool(edges & 1)):
+                    torn[0] += 1
+                snapshots[0] += 1
+    
+    threads = [threading.Thread(target=writer, args=(pin,)) for pin in pins]
+    threads += [threading.Thread(target=reader) for _ in range(args.readers)]
+    switch_interval = sys.getswitchinterval()
+    sys.setswitchinterval(1e-6)
+    try:
+        for thread in threads:
+            thread.start()
+        start_barrier.wait()
+        started = time.perf_counter()
+        for thread in threads[:len(pins)]:
+            thread.join()
+        elapsed = time.perf_counter() - started
+        done.set()
+        for thread in threads[len(pins):]:
+            thread.join()
+    finally:
+        sys.setswitchinterval(switch_interval)
+    
+    failures = []
+    if torn[0]:
+        failures.append(f"{torn[0]} torn snapshots")
+    for pin in pins:
+        events = submitted[pin]
+        level, since_ns, edges = monitor.pin_slots[pin].snapshot()
+        if len(events) != args.edges or edges != args.edges:
+            failures.append(f"pin {pin}: {len(events)} events submitted, slot counted {edges}, expected {args.edges}")
+            continue
+        bad = [event for event in events if abs(event['time_diff_sec'] - steps[pin] / 1e9) > 1e-12]
+        if bad:
+            failures.append(f"pin {pin}: {len(bad)} wrong durations")
+        if since_ns != initial[pin][1] + args.edges * steps[pin]:
+            failures.append(f"pin {pin}: final timestamp off by {since_ns - initial[pin][1] - args.edges * steps[pin]} ns")
+    
+    monitor.cleanup()
+    listener.close()
+    
+    total = args.edges * len(pins)
+    print(f"pins {len(pins)}  edges {total}  snapshots {snapshots[0]}  "
+          f"{total / elapsed:.0f} edges/s across all writers")
+    if failures:
+        for failure in failures:
+            print(f"FAIL: {failure}")
+        sys.exit(1)
+    print("OK: no torn snapshots, no lost edges or durations")
+
+if __name__ == "__main__":
+    main()
@@ -2,12 +2,17 @@
 """
 Raspberry Pi 5 GPIO Pin Monitor with Network Reconnection
 This program monitors 4 GPIO pins for switch changes and sends the data to a server.
-Uses gpiozero for better compatibility with Raspberry Pi 5.
+Uses gpiozero for better compatibility with Raspberry Pi 5, or libgpiod for
+kernel-timestamped edge capture.
 Includes network monitoring and automatic reconnection capabilities.
 """
 
-from gpiozero import Button
+try:
+    from gpiozero import Button
+except ImportError:
+    Button = None  # Allows importing this module off the Pi (benchmarks, tools)
 import socket
+import errno
 import time
 import json
 import configparser
@@ -18,21 +23,40 @@ import logging
 from logging.handlers import RotatingFileHandler
 import subprocess
 import threading
-from queue import Queue
+import struct
+import zlib
+import select
+import fcntl
+import heapq
+import bisect
+import itertools
+import random
+from collections import OrderedDict, deque
+from queue import Queue, SimpleQueue, Empty, Full
 import urllib.request
+import urllib.parse
+import socketserver
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from andon_protocol import (FRAME_HEADER, MAX_FRAME_SIZE, PROTOCOL_VERSION, SUPPORTED_ENCODINGS,
+                            ProtocolError, TimestampFormatter, encode_batch)
+from andon_ring import RingWriter
 
 # Setup logging
 log_formatter = logging.Formatter('%(asctime)s - %(levelname)s - %(message)s')
 log_file = '/var/log/gpio_monitor.log'
-log_handler = RotatingFileHandler(log_file, maxBytes=5*1024*1024, backupCount=3)
-log_handler.setFormatter(log_formatter)
+try:
+    log_handler = RotatingFileHandler(log_file, maxBytes=5*1024*1024, backupCount=3)
+    log_handler.setFormatter(log_formatter)
+except OSError:
+    log_handler = None  # Not running as a service (no access to /var/log)
 
 console_handler = logging.StreamHandler(sys.stdout)
 console_handler.setFormatter(log_formatter)
 
 logger = logging.getLogger('gpio_monitor')
 logger.setLevel(logging.INFO)
-logger.addHandler(log_handler)
+if log_handler:
+    logger.addHandler(log_handler)
 logger.addHandler(console_handler)
 
 # Default configuration
@@ -42,41 +66,2139 @@ DEFAULT_CONFIG = {
     },
     'server': {
         'ip': '192.168.1.128',
-        'port': 5000
+        'port': 5000,
+        'endpoints': '',  # collectors as host[:port],... in order of preference; empty = ip and port
+        'mode': 'failover',  # with several endpoints: 'failover' (one at a time) or 'fanout' (every event to each)
+        'protocol': 'framed',  # 'framed' (persistent session) or 'legacy' (connect per event)
+        'encoding': 'bin1',  # preferred event encoding on framed sessions: 'bin1' or 'json'
+        'timeout': 5,  # seconds to wait for connect/acknowledgement
+        'keepalive_idle': 10,  # seconds a session may be silent before TCP keepalive probes start
+        'keepalive_interval': 5,  # seconds between keepalive probes
+        'keepalive_count': 3,  # unanswered keepalive probes before the session is dropped
+        'user_timeout': 20  # seconds sent data may stay unacknowledged by TCP before the session is dropped
     },
     'gpio': {
-        'pins': '23,24,25,12',
-        'debounce_time': 100  # milliseconds
+        'pins': '23,24,25,12',  # replaced by the pins of [station:<name>] sections, if any
+        'debounce_time': 100,  # milliseconds, for every pin without its own setting
+        'pin_debounce': '',  # per-pin overrides in ms or 'adaptive', e.g. 23:20,24:adaptive
+        'adaptive_min_ms': 1,  # bounds of the window an adaptive pin learns
+        'adaptive_max_ms': 50,
+        'backend': 'gpiozero',  # 'gpiozero', 'gpiod' (kernel timestamps), 'bank' (bulk sampling),
+                                # 'simulated', 'simulated-bank', 'synthetic' or 'replay'
+        'sample_interval_ms': 1.0,  # how often the bank backend reads all pins
+        'chip': '/dev/gpiochip0',  # GPIO character device used by the gpiod backend
+        'record_trace': ''  # if set, every captured edge is also written to this trace file
+    },
+    'simulation': {
+        'trace': '',  # trace file played by the replay backend
+        'speed': 1.0,  # playback speed factor for synthetic/replay (0 = as fast as possible)
+        'loop': 'false',  # restart the trace when it ends
+        'autostart': 'true',  # false: hold synthetic/replay edges until source.release() (benchmarks)
+        'profile': 'poisson',  # synthetic profile for every pin: poisson, chatter or hold
+        'pin_profiles': '',  # per-pin overrides, e.g. 23:chatter,24:hold
+        'rate': 0.2,  # synthetic edges per second per pin
+        'hold_time': 300,  # mean seconds a 'hold' pin stays pressed
+        'chatter_rate': 200,  # toggles per second while a 'chatter' contact bounces
+        'chatter_duration': 0.5,  # max seconds a 'chatter' contact bounces per transition
+        'duration': 0,  # stop synthetic traffic after this many seconds (0 = never)
+        'seed': ''  # random seed for reproducible synthetic traffic
+    },
+    'chatter': {
+        'enabled': 'true',  # summarize pins that toggle faster than the threshold
+        'threshold': 20,  # toggles within 'window' that put a pin into chatter mode
+        'window': 1.0,  # seconds
+        'summary_interval': 10,  # seconds between summary events while a pin chatters
+        'quiet_time': 5  # seconds without a toggle before a pin leaves chatter mode
+    },
+    'ring': {
+        'enabled': 'false',  # publish every edge to a shared-memory ring for local consumers
+        'path': '/dev/shm/andon_ring',
+        'slots': 4096  # events kept in the ring (power of two)
+    },
+    'query': {
+        'enabled': 'false',  # local read-only endpoint for current pin states and recent events
+        'bind': '127.0.0.1',
+        'port': 8765,  # HTTP port (0 disables HTTP)
+        'unix_socket': '',  # also serve HTTP on this Unix socket, e.g. /run/gpio_monitor/query.sock
+        'recent': 200  # events and sends kept for the endpoint
+    },
+    'sender': {
+        'queue_size': 1000,  # max edges buffered between GPIO callbacks and the sender thread
+        'stats_interval': 300,  # seconds between pipeline statistics log lines (0 disables)
+        'linger_ms': 5,  # how long to wait for more edges before sending a batch
+        'max_batch': 50,  # max events per batch frame
+        'window': 1000,  # max events sent but not yet acknowledged
+        'ack_timeout': 10,  # seconds without acknowledgement before the session is reset
+        'sequence_file': '/var/lib/gpio_monitor/sequence'  # persisted event sequence numbers
+    },
+    'journal': {
+        'path': '/var/lib/gpio_monitor/journal',  # store-and-forward spool for offline events
+        'segment_size': 1048576,  # bytes per segment file
+        'max_size': 67108864,  # disk budget in bytes; oldest segments are discarded beyond it
+        'fsync_interval': 2.0,  # max seconds between fsyncs of appended events
+        'replay_batch': 500  # events per batch frame when replaying a backlog
     },
     'network': {
-        'check_interval': 30,  # seconds between network checks
-        'reconnect_timeout': 300,  # max seconds to spend trying to reconnect
+        'check_interval': 30,  # seconds of idle link before an active check; also the interval after an outage
+        'check_interval_max': 300,  # the idle check interval doubles up to this while the link stays stable
+        'reconnect_timeout': 300,  # seconds of outage before it is logged as an error (retries continue)
+        'reconnect_backoff_min': 1.0,  # seconds before the first retry round; doubles each round
+        'reconnect_backoff_max': 30.0,  # cap on the (jittered) wait between retry rounds
         'wifi_interface': 'wlan0',
         'ethernet_interface': 'eth0',
         'gateway_check': 'true',  # Check default gateway connectivity
+        'probe_timeout': 2.0,  # seconds allowed for one round of reachability probes
+        'probe_port': 80,  # TCP port probed on the gateway where unprivileged ICMP isn't permitted
+        'uplinks': '',  # interfaces to keep a collector session on each, in order of preference, e.g. eth0,wlan0
+        'link_monitor': 'netlink',  # 'netlink' (kernel pushes link/address/route changes) or 'poll' (ip commands)
         'server_check': 'true'   # Check server connectivity
     }
 }
 
 CONFIG_FILE = '/etc/gpio_monitor.conf'
 
+class ServerSession:
+    """Long-lived, length-framed TCP session to the collector.
+
+    The session is opened once (or pre-warmed when the network comes up) and
+    reused for every frame. Sending and receiving are decoupled: frames are
+    written by the sender thread while a reader thread hands every message
+    from the server (acknowledgements) to on_message. Each successful
+    connect increments generation so users can tell a fresh session apart.
+    Connect, send and acknowledgement times go to metrics (NetworkMetrics)
+    under the session's name.
+    """
+    def __init__(self, server_ip, server_port, device_name, timeout=5, encoding='bin1',
+                 keepalive=(10, 5, 3), user_timeout=20, interface=None, source_address=None,
+                 metrics=None):
+        self.server_ip = server_ip
+        self.server_port = server_port
+        self.device_name = device_name
+        self.timeout = timeout
+        self.interface = interface  # network device the session is bound to, if any
+        self.source_address = source_address  # callable giving an interface's IPv4 address
+        self.name = f"{server_ip}:{server_port}" + (f"%{interface}" if interface else '')
+        self.handshake_rtt = None  # seconds from hello to welcome on the last connect
+        # Send times of the batch frames not answered yet, oldest first: the
+        # server acknowledges every batch frame, in order
+        self.awaiting = deque()
+        self.ack_rtt = None  # wait of the frame just acknowledged, set before on_message runs
+        self.ack_lock = threading.Lock()  # guards awaiting; never held across socket I/O
+        self.metrics = metrics
+        self.keepalive = keepalive  # (idle, interval, count) seconds/probes, or None
+        self.user_timeout = user_timeout
+        self.sock = None
+        self.lock = threading.Lock()
+        self.generation = 0
+        self.welcome = {}
+        
+        # Offer the preferred encoding first; JSON is the universal fallback
+        self.offered_encodings = [encoding] + [e for e in SUPPORTED_ENCODINGS if e != encoding]
+        self.encoding = 'json'
+        self.on_message = None
+        self.on_lost = None  # called (reader thread) when the session fails underneath its users
+    
+    def is_open(self):
+        return self.sock is not None
+    
+    def connect(self):
+        """Establish the session if it is not already open; returns True if open"""
+        with self.lock:
+            if self.sock is not None:
+                return True
+            try:
+                self._open()
+                return True
+            except (OSError, ProtocolError, ValueError) as e:
+                logger.debug(f"Could not open session to {self.server_ip}:{self.server_port}: {e}")
+                self._close_socket()
+                return False
+    
+    def close(self):
+        """Close the session; the next connect re-establishes it"""
+        with self.lock:
+            self._close_socket()
+    
+    def reset(self):
+        """Drop a session that stopped answering"""
+        self.close()
+    
+    def send_frame(self, payload, acked=True):
+        """Write one frame; closes the session and re-raises on failure.
+
+        acked says the server answers the frame (sequenced batches do,
+        notices don't), so it counts towards the acknowledgement round trip.
+        """
+        with self.lock:
+            if self.sock is None:
+                raise ConnectionResetError("Session is not open")
+            started = time.monotonic()
+            if acked:
+                # Before sending, so the acknowledgement cannot arrive first
+                with self.ack_lock:
+                    self.awaiting.append(started)
+            try:
+                self.sock.sendall(FRAME_HEADER.pack(len(payload)) + payload)
+            except OSError:
+                self._close_socket()
+                raise
+            if self.metrics:
+                self.metrics.record(self.name, 'send', time.monotonic() - started)
+    
+    def _connect_socket(self):
+        """TCP connection to the collector, leaving through interface if one is set"""
+        if not self.interface:
+            return socket.create_connection((self.server_ip, self.server_port), timeout=self.timeout)
+        s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        try:
+            try:
+                s.setsockopt(socket.SOL_SOCKET, socket.SO_BINDTODEVICE, self.interface.encode())
+            except PermissionError:
+                # Without CAP_NET_RAW, bind to the interface's address instead; the
+                # route out then has to follow the source address (policy routing)
+                address = self.source_address(self.interface) if self.source_address else None
+                if not address:
+                    raise OSError(errno.EADDRNOTAVAIL, f"{self.interface} has no IPv4 address")
+                s.bind((address, 0))
+            s.settimeout(self.timeout)
+            s.connect((self.server_ip, self.server_port))
+        except OSError:
+            s.close()
+            raise
+        return s
+    
+    def _open(self):
+        started = time.monotonic()
+        s = self._connect_socket()
+        if self.metrics:
+            self.metrics.record(self.name, 'connect', time.monotonic() - started)
+        s.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        # The kernel watches an idle session for us, so its health needs no extra connections
+        if self.keepalive:
+            idle, interval, count = self.keepalive
+            s.setsockopt(socket.SOL_SOCKET, socket.SO_KEEPALIVE, 1)
+            s.setsockopt(socket.IPPROTO_TCP, socket.TCP_KEEPIDLE, idle)
+            s.setsockopt(socket.IPPROTO_TCP, socket.TCP_KEEPINTVL, interval)
+            s.setsockopt(socket.IPPROTO_TCP, socket.TCP_KEEPCNT, count)
+        if self.user_timeout:
+            s.setsockopt(socket.IPPROTO_TCP, socket.TCP_USER_TIMEOUT, int(self.user_timeout * 1000))
+        self.sock = s
+        
+        hello = {
+            'type': 'hello',
+            'device_name': self.device_name,
+            'protocol': PROTOCOL_VERSION,
+            'encodings': self.offered_encodings
+        }
+        started = time.monotonic()
+        s.sendall(self._frame(json.dumps(hello).encode('utf-8')))
+        
+        buffer = bytearray()
+        welcome = json.loads(self._recv_frame(s, buffer))
+        self.handshake_rtt = time.monotonic() - started
+        if welcome.get('type') != 'welcome':
+            raise ProtocolError(f"Server rejected session: {welcome}")
+        
+        self.welcome = welcome
+        self.encoding = welcome.get('encoding', 'json')
+        if self.encoding not in SUPPORTED_ENCODINGS:
+            raise ProtocolError(f"Server chose unsupported encoding {self.encoding}")
+        self.generation += 1
+        
+        reader = threading.Thread(target=self._reader_loop, args=(s, buffer),
+                                  name='session-reader', daemon=True)
+        reader.start()
+        via = f" via {self.interface}" if self.interface else ''
+        logger.info(f"Session established to {self.server_ip}:{self.server_port}{via} ({self.encoding} encoding)")
+    
+    def _reader_loop(self, sock, buffer):
+        """Dispatch server messages until the socket is closed or fails"""
+        while True:
+            try:
+                message = json.loads(self._recv_frame(sock, buffer))
+            except socket.timeout:
+                continue
+            except (OSError, ProtocolError, ValueError) as e:
+                with self.lock:
+                    lost = self.sock is sock
+                    if lost:
+                        logger.warning(f"Session to {self.server_ip}:{self.server_port} lost: {e}")
+                        self._close_socket()
+                if lost and self.on_lost:
+                    self.on_lost()
+                return
+            
+            sent = None
+            if message.get('type') == 'ack':
+                with self.ack_lock:
+                    if self.awaiting:
+                        sent = self.awaiting.popleft()
+            self.ack_rtt = time.monotonic() - sent if sent is not None else None
+            if self.ack_rtt is not None and self.metrics:
+                self.metrics.record(self.name, 'ack', self.ack_rtt)
+            if self.on_message:
+                try:
+                    self.on_message(message)
+                except Exception as e:
+                    logger.error(f"Error handling server message: {e}")
+    
+    def _close_socket(self):
+        if self.sock is not None:
+            try:
+                self.sock.shutdown(socket.SHUT_RDWR)
+            except OSError:
+                pass
+            try:
+                self.sock.close()
+            except OSError:
+                pass
+            self.sock = None
+        with self.ack_lock:
+            self.awaiting.clear()
+    
+    @staticmethod
+    def _frame(payload):
+        return FRAME_HEADER.pack(len(payload)) + payload
+    
+    @staticmethod
+    def _recv_frame(sock, buffer):
+        """Read exactly one frame, buffering partial reads and any extra bytes"""
+        while True:
+            if len(buffer) >= FRAME_HEADER.size:
+                (length,) = FRAME_HEADER.unpack_from(buffer)
+                if length > MAX_FRAME_SIZE:
+                    raise ProtocolError(f"Frame of {length} bytes exceeds limit")
+                end = FRAME_HEADER.size + length
+                if len(buffer) >= end:
+                    payload = bytes(buffer[FRAME_HEADER.size:end])
+                    del buffer[:end]
+                    return payload
+            
+            chunk = sock.recv(4096)
+            if not chunk:
+                raise ConnectionResetError("Server closed the session")
+            buffer.extend(chunk)
+
+class PathHealth:
+    """Health of one path to a collector, as a cost in milliseconds (lower is healthier).
+
+    The cost is the smoothed round trip of the path - welcome handshakes and
+    frame acknowledgements - plus a penalty per recent error (send failure,
+    lost session, failed connect or unanswered frames), decaying with a
+    half-life so a path that failed earns its way back, and a fixed amount
+    per place in the configured order of preference.
+    """
+    RTT_SMOOTHING = 0.2
+    ERROR_COST_MS = 200.0
+    ERROR_HALF_LIFE = 30.0
+    RANK_COST_MS = 50.0
+    RETRY_MIN = 1.0  # seconds before a path that failed to connect is tried again; doubles per failure
+    RETRY_MAX = 30.0
+    
+    def __init__(self, rank):
+        self.rank = rank
+        self.rtt_ms = None
+        self.errors = 0.0
+        self.updated = time.monotonic()
+        self.connect_failures = 0
+        self.retry_at = 0.0
+    
+    def decay(self, now):
+        self.errors *= 0.5 ** ((now - self.updated) / self.ERROR_HALF_LIFE)
+        self.updated = now
+    
+    def rtt_sample(self, seconds):
+        ms = seconds * 1000
+        self.rtt_ms = ms if self.rtt_ms is None else self.rtt_ms + (ms - self.rtt_ms) * self.RTT_SMOOTHING
+    
+    def error(self):
+        self.decay(time.monotonic())
+        self.errors += 1
+    
+    def connected(self, handshake_rtt):
+        self.connect_failures = 0
+        self.retry_at = 0.0
+        self.rtt_sample(handshake_rtt)
+    
+    def connect_failed(self):
+        self.error()
+        self.connect_failures += 1
+        delay = min(self.RETRY_MAX, self.RETRY_MIN * 2 ** (self.connect_failures - 1))
+        self.retry_at = time.monotonic() + delay
+    
+    def cost(self):
+        self.decay(time.monotonic())
+        return (self.rtt_ms or 0.0) + self.errors * self.ERROR_COST_MS + self.rank * self.RANK_COST_MS
+
+class MultipathSession:
+    """Sessions to the collector over several paths at once, used one at a time.
+
+    A path is a ServerSession to one collector endpoint, optionally bound to
+    one uplink interface; every path whose interface is up is kept open.
+    Frames go out on the active path, the open one with the lowest
+    PathHealth cost; another path only takes over from a working one when it
+    is cheaper by SWITCH_MARGIN_MS, so traffic does not flap between equals.
+    When the active path fails - a send error, an acknowledgement timeout,
+    keepalive giving up or its link going down - the next open path takes
+    over at once and generation changes, so the delivery channel
+    retransmits its unacknowledged events there. A collector keeps delivery
+    state per device rather than per session, so events that did get through
+    on the failed path are acknowledged, not written twice; after a switch
+    to another collector they may reach both.
+    """
+    SWITCH_MARGIN_MS = 25.0
+    
+    def __init__(self, paths):
+        self.paths = paths  # ServerSessions in order of preference
+        self.health = {path: PathHealth(rank) for rank, path in enumerate(paths)}
+        self.device_name = paths[0].device_name
+        self.lock = threading.Lock()
+        self.active = None
+        self.active_key = None  # (path, path generation) the current generation stands for
+        self.generation = 0
+        self.switches = 0
+        self.message_handler = None
+        self.on_lost = None  # called (reader thread) when the last open path fails
+        self.on_switch = None  # called after traffic moved to another already open path
+        for path in paths:
+            path.on_lost = lambda path=path: self.path_lost(path)
+            path.on_message = lambda message, path=path: self.path_message(path, message)
+    
+    @property
+    def on_message(self):
+        return self.message_handler
+    
+    @on_message.setter
+    def on_message(self, handler):
+        self.message_handler = handler
+    
+    @property
+    def current(self):
+        return self.active or self.paths[0]
+    
+    @property
+    def server_ip(self):
+        return self.current.server_ip
+    
+    @property
+    def server_port(self):
+        return self.current.server_port
+    
+    @property
+    def encoding(self):
+        return self.current.encoding
+    
+    @property
+    def welcome(self):
+        return self.current.welcome
+    
+    def is_open(self):
+        active = self.active
+        return active is not None and active.is_open()
+    
+    def select(self):
+        """Make the healthiest open path active; returns True if there is one"""
+        switched = None
+        with self.lock:
+            previous = self.active
+            candidates = [path for path in self.paths if path.is_open()]
+            if not candidates:
+                self.active = None
+                return False
+            best = min(candidates, key=lambda path: self.health[path].cost())
+            if (previous in candidates and best is not previous and
+                    self.health[best].cost() > self.health[previous].cost() - self.SWITCH_MARGIN_MS):
+                best = previous
+            self.active = best
+            key = (best, best.generation)
+            if key != self.active_key:
+                self.active_key = key
+                self.generation += 1
+                if previous is not None and previous is not best:
+                    self.switches += 1
+                    switched = previous
+        if switched:
+            logger.warning(f"Collector traffic moved from {switched.name} to {best.name}")
+            if self.on_switch:
+                self.on_switch()
+        return True
+    
+    def open_path(self, path):
+        """Connect one path unless it is backing off after failed attempts"""
+        health = self.health[path]
+        if path.is_open():
+            return True
+        if time.monotonic() < health.retry_at:
+            return False
+        if path.connect():
+            health.connected(path.handshake_rtt)
+            return True
+        health.connect_failed()
+        return False
+    
+    def connect(self):
+        """Use an open path, or open the healthiest one that connects; returns True if open"""
+        if self.is_open() or self.select():
+            return True
+        for path in sorted(self.paths, key=lambda path: self.health[path].cost()):
+            if self.open_path(path):
+                break
+        return self.select()
+    
+    def close(self):
+        for path in self.paths:
+            path.close()
+        with self.lock:
+            self.active = None
+    
+    def reset(self):
+        """Give up on the active path because it stopped answering; another takes over"""
+        active = self.active
+        if active is not None:
+            self.health[active].error()
+            active.close()
+        self.select()
+    
+    def send_frame(self, payload, acked=True):
+        """Write one frame on the active path; on failure switch paths and re-raise"""
+        active = self.active
+        if active is None:
+            raise ConnectionResetError("Session is not open")
+        try:
+            active.send_frame(payload, acked)
+        except OSError:
+            self.health[active].error()
+            self.select()
+            raise
+    
+    def path_message(self, path, message):
+        if path.ack_rtt is not None:
+            self.health[path].rtt_sample(path.ack_rtt)
+        if self.message_handler:
+            self.message_handler(message)
+    
+    def path_lost(self, path):
+        self.health[path].error()
+        if path is self.active and not self.select() and self.on_lost:
+            self.on_lost()
+    
+    def maintain(self, interface_up, reconnect=True):
+        """Close paths whose interface is down and (re)open the others (any thread if not reconnecting)"""
+        for path in self.paths:
+            if path.interface and not interface_up(path.interface):
+                if path.is_open():
+                    logger.info(f"Uplink {path.interface} is down, closing session {path.name}")
+                    path.close()
+            elif reconnect:
+                self.open_path(path)
+        self.select()
+    
+    def get_stats(self):
+        active = self.active
+        paths = {}
+        for path in self.paths:
+            health = self.health[path]
+            paths[path.name] = {'open': path.is_open(), 'cost_ms': round(health.cost(), 1),
+                                'rtt_ms': round(health.rtt_ms, 3) if health.rtt_ms is not None else None,
+                                'errors': round(health.errors, 2)}
+        return {'path': active.name if active else None,
+                'paths_open': sum(1 for path in self.paths if path.is_open()),
+                'path_switches': self.switches,
+                'paths': paths}
+
+class SequenceCounter:
+    """Per-device event sequence numbers that keep increasing across restarts.
+
+    Numbers are reserved from a state file in blocks, so the file is only
+    rewritten once every block_size events. A crash skips the rest of the
+    current block, which is harmless since the numbers only have to increase.
+    """
+    def __init__(self, path, block_size=1000):
+        self.path = path
+        self.block_size = block_size
+        self.lock = threading.Lock()
+        self.next_seq = 1
+        self.reserved_until = 0
+        
+        try:
+            with open(path) as f:
+                self.next_seq = int(f.read().strip())
+            self.reserved_until = self.next_seq - 1
+        except (OSError, ValueError):
+            logger.info(f"No usable sequence state in {path}, starting at 1")
+    
+    def next(self):
+        with self.lock:
+            if self.next_seq > self.reserved_until:
+                self._reserve()
+            seq = self.next_seq
+            self.next_seq += 1
+            return seq
+    
+    def _reserve(self):
+        limit = self.next_seq + self.block_size
+        try:
+            os.makedirs(os.path.dirname(self.path), exist_ok=True)
+            tmp_file = self.path + '.tmp'
+            with open(tmp_file, 'w') as f:
+                f.write(str(limit))
+                f.flush()
+                os.fsync(f.fileno())
+            os.replace(tmp_file, self.path)
+        except OSError as e:
+            logger.error(f"Could not persist sequence state to {self.path}: {e}")
+        self.reserved_until = limit - 1
+
+class SenderPipeline:
+    """Bounded queue decoupling GPIO callbacks from network I/O.
+
+    Callbacks only enqueue an already timestamped edge; a dedicated worker
+    thread dequeues edges in order and hands them to the send handler in
+    batches. After the first edge of a batch arrives the worker lingers for
+    up to linger seconds to collect more, so a burst of edges is sent as one
+    frame.
+    """
+    POKE = object()  # queued by poke() to run the idle handler without waiting
+    
+    def __init__(self, handler, queue_size=1000, idle_handler=None, idle_interval=1.0,
+                 linger=0.005, max_batch=50):
+        self.handler = handler
+        self.linger = linger
+        self.max_batch = max(1, max_batch)
+        self.idle_handler = idle_handler
+        self.idle_interval = idle_interval
+        self.queue = Queue(maxsize=queue_size)
+        self.running = False
+        self.thread = None
+        
+        # Statistics
+        self.stats_lock = threading.Lock()
+        self.enqueued = 0
+        self.dropped = 0
+        self.processed = 0
+        self.max_depth = 0
+        self.latency_total = 0.0
+        self.latency_max = 0.0
+    
+    def start(self):
+        self.running = True
+        self.thread = threading.Thread(target=self.worker_loop, name='sender', daemon=True)
+        self.thread.start()
+    
+    def stop(self, timeout=5):
+        """Stop the worker after it has drained the edges already queued"""
+        if not self.running:
+            return
+        self.running = False
+        try:
+            self.queue.put(None, timeout=timeout)
+        except Full:
+            pass
+        self.thread.join(timeout)
+    
+    def submit(self, event):
+        """Enqueue an edge without blocking; returns False if the queue is full"""
+        event['enqueued_at'] = time.monotonic()
+        try:
+            self.queue.put_nowait(event)
+        except Full:
+            with self.stats_lock:
+                self.dropped += 1
+            return False
+        
+        depth = self.queue.qsize()
+        with self.stats_lock:
+            self.enqueued += 1
+            if depth > self.max_depth:
+                self.max_depth = depth
+        return True
+    
+    def poke(self):
+        """Have the worker run the idle handler as soon as it is free (any thread)"""
+        try:
+            self.queue.put_nowait(self.POKE)
+        except Full:
+            pass  # the worker is busy with edges, which pump the channel anyway
+    
+    def worker_loop(self):
+        logger.info("Sender thread started")
+        
+        while True:
+            try:
+                event = self.queue.get(timeout=self.idle_interval)
+            except Empty:
+                event = self.POKE
+            if event is self.POKE:
+                # Housekeeping (journal replay, fsync) while no edges arrive, or when poked
+                if self.idle_handler:
+                    try:
+                        self.idle_handler()
+                    except Exception as e:
+                        logger.error(f"Error in sender idle handler: {e}")
+                continue
+            if event is None:
+                break
+            
+            batch = [event]
+            stopping = self.collect_batch(batch)
+            
+            now = time.monotonic()
+            with self.stats_lock:
+                for event in batch:
+                    latency = now - event.pop('enqueued_at')
+                    self.processed += 1
+                    self.latency_total += latency
+                    if latency > self.latency_max:
+                        self.latency_max = latency
+            
+            try:
+                self.handler(batch)
+            except Exception as e:
+                logger.error(f"Error handling pin events: {e}")
+            
+            if stopping:
+                break
+    
+    def collect_batch(self, batch):
+        """Add edges arriving within the linger window; returns True if stop was requested"""
+        deadline = time.monotonic() + self.linger
+        while len(batch) < self.max_batch:
+            remaining = deadline - time.monotonic()
+            try:
+                if remaining > 0:
+                    event = self.queue.get(timeout=remaining)
+                else:
+                    event = self.queue.get_nowait()
+            except Empty:
+                return False
+            if event is None:
+                return True
+            if event is not self.POKE:
+                batch.append(event)
+        return False
+    
+    def get_stats(self):
+        """Snapshot of queue depth and enqueue-to-send latency"""
+        with self.stats_lock:
+            avg = self.latency_total / self.processed if self.processed else 0.0
+            return {
+                'queue_depth': self.queue.qsize(),
+                'queue_max_depth': self.max_depth,
+                'enqueued': self.enqueued,
+                'dropped': self.dropped,
+                'processed': self.processed,
+                'latency_avg_ms': round(avg * 1000, 3),
+                'latency_max_ms': round(self.latency_max * 1000, 3)
+            }
+
+class EventJournal:
+    """Append-only, segmented on-disk journal for events that could not be sent.
+
+    Records are stored as a length + CRC32 header followed by the JSON payload,
+    so a torn write at the tail (power loss) is detected and truncated when the
+    journal is reopened. Appends are fsynced in batches at most fsync_interval
+    seconds apart. The position of the first unacknowledged record is kept in
+    a cursor file, and segments that lie entirely before it are deleted.
+    """
+    RECORD_HEADER = struct.Struct('!II')
+    SEGMENT_SUFFIX = '.seg'
+    
+    def __init__(self, path, segment_size=1048576, max_size=67108864, fsync_interval=2.0):
+        self.path = path
+        self.segment_size = segment_size
+        self.max_size = max_size
+        self.fsync_interval = fsync_interval
+        self.cursor_file = os.path.join(path, 'cursor')
+        self.lock = threading.Lock()
+        
+        self.write_file = None
+        self.write_segment = 0
+        self.unsynced = 0
+        self.last_sync = time.monotonic()
+        self.read_pos = (0, 0)  # next record to hand out for replay
+        self.commit_pos = (0, 0)  # first record not yet acknowledged
+        self.appended = 0
+        self.discarded = 0
+        
+        os.makedirs(path, exist_ok=True)
+        self._recover()
+    
+    def _segment_path(self, segment):
+        return os.path.join(self.path, f"{segment:012d}{self.SEGMENT_SUFFIX}")
+    
+    def _list_segments(self):
+        return sorted(int(name[:-len(self.SEGMENT_SUFFIX)]) for name in os.listdir(self.path)
+                      if name.endswith(self.SEGMENT_SUFFIX))
+    
+    def _recover(self):
+        """Load the cursor and truncate any partially written record at the tail"""
+        segments = self._list_segments()
+        
+        try:
+            with open(self.cursor_file) as f:
+                segment, offset = (int(x) for x in f.read().split())
+                self.commit_pos = (segment, offset)
+        except (OSError, ValueError):
+            self.commit_pos = (segments[0], 0) if segments else (0, 0)
+        
+        if segments and self.commit_pos[0] < segments[0]:
+            self.commit_pos = (segments[0], 0)
+        
+        if segments:
+            self.write_segment = segments[-1]
+            valid_end = self._scan_valid_end(self.write_segment)
+            with open(self._segment_path(self.write_segment), 'r+b') as f:
+                f.truncate(valid_end)
+        else:
+            self.write_segment = self.commit_pos[0]
+        
+        self.write_file = open(self._segment_path(self.write_segment), 'ab')
+        self.commit_pos = self._normalize(self.commit_pos)
+        self.read_pos = self.commit_pos
+        
+        if self.has_backlog():
+            logger.info(f"Journal recovered with {self._size_on_disk()} bytes of unsent events")
+    
+    def _scan_valid_end(self, segment):
+        offset = 0
+        with open(self._segment_path(segment), 'rb') as f:
+            while True:
+                header = f.read(self.RECORD_HEADER.size)
+                if len(header) < self.RECORD_HEADER.size:
+                    break
+                length, crc = self.RECORD_HEADER.unpack(header)
+                payload = f.read(length)
+                if len(payload) < length or zlib.crc32(payload) != crc:
+                    logger.warning(f"Truncating torn journal record in segment {segment} at offset {offset}")
+                    break
+                offset += self.RECORD_HEADER.size + length
+        return offset
+    
+    def _size_on_disk(self):
+        total = 0
+        for segment in self._list_segments():
+            try:
+                total += os.path.getsize(self._segment_path(segment))
+            except OSError:
+                pass
+        return total
+    
+    def has_backlog(self):
+        """True if there are events that have not been acknowledged yet"""
+        return self.commit_pos != (self.write_segment, self.write_file.tell())
+    
+    def append(self, data):
+        payload = json.dumps(data).encode('utf-8')
+        record = self.RECORD_HEADER.pack(len(payload), zlib.crc32(payload)) + payload
+        
+        with self.lock:
+            if self.write_file.tell() > 0 and self.write_file.tell() + len(record) > self.segment_size:
+                self._roll_segment()
+            self.write_file.write(record)
+            self.appended += 1
+            self.unsynced += 1
+            self._maybe_sync()
+    
+    def sync(self, force=False):
+        """Flush and fsync pending appends if the batching interval has elapsed"""
+        with self.lock:
+            self._maybe_sync(force)
+    
+    def _maybe_sync(self, force=False):
+        if not self.unsynced:
+            return
+        if force or time.monotonic() - self.last_sync >= self.fsync_interval:
+            self.write_file.flush()
+            os.fsync(self.write_file.fileno())
+            self.unsynced = 0
+            self.last_sync = time.monotonic()
+    
+    def _roll_segment(self):
+        self._maybe_sync(force=True)
+        self.write_file.close()
+        self.write_segment += 1
+        self.write_file = open(self._segment_path(self.write_segment), 'ab')
+        
+        # Make the new directory entry durable
+        dir_fd = os.open(self.path, os.O_RDONLY)
+        try:
+            os.fsync(dir_fd)
+        finally:
+            os.close(dir_fd)
+        
+        self._enforce_budget()
+    
+    def _enforce_budget(self):
+        """Discard the oldest segments while the journal exceeds its disk budget"""
+        segments = self._list_segments()
+        while len(segments) > 1 and self._size_on_disk() > self.max_size:
+            oldest = segments.pop(0)
+            dropped = self._count_records(oldest)
+            os.remove(self._segment_path(oldest))
+            self.discarded += dropped
+            logger.error(f"Journal over {self.max_size} byte budget, discarded {dropped} oldest events")
+            if self.commit_pos[0] <= oldest:
+                self._write_cursor((segments[0], 0))
+            if self.read_pos[0] <= oldest:
+                self.read_pos = (segments[0], 0)
+    
+    def _count_records(self, segment):
+        count = 0
+        with open(self._segment_path(segment), 'rb') as f:
+            while True:
+                header = f.read(self.RECORD_HEADER.size)
+                if len(header) < self.RECORD_HEADER.size:
+                    return count
+                length, _ = self.RECORD_HEADER.unpack(header)
+                f.seek(length, os.SEEK_CUR)
+                count += 1
+    
+    def read_batch(self, max_records):
+        """Return up to max_records (data, position_after) pairs in append order"""
+        with self.lock:
+            self.write_file.flush()
+            records = []
+            segment, offset = self.read_pos
+            
+            while len(records) < max_records:
+                try:
+                    f = open(self._segment_path(segment), 'rb')
+                except FileNotFoundError:
+                    if segment >= self.write_segment:
+                        break
+                    segment, offset = segment + 1, 0
+                    continue
+                
+                with f:
+                    f.seek(offset)
+                    while len(records) < max_records:
+                        header = f.read(self.RECORD_HEADER.size)
+                        if len(header) < self.RECORD_HEADER.size:
+                            break
+                        length, crc = self.RECORD_HEADER.unpack(header)
+                        payload = f.read(length)
+                        offset += self.RECORD_HEADER.size + length
+                        if zlib.crc32(payload) != crc:
+                            logger.error(f"Skipping corrupt journal record in segment {segment}")
+                            continue
+                        records.append((json.loads(payload), (segment, offset)))
+                
+                if len(records) >= max_records or segment >= self.write_segment:
+                    break
+                segment, offset = segment + 1, 0
+            
+            self.read_pos = (segment, offset)
+            return records
+    
+    def commit(self, position):
+        """Mark everything before position as acknowledged and trim finished segments"""
+        with self.lock:
+            self._write_cursor(self._normalize(position))
+            for segment in self._list_segments():
+                if segment >= position[0]:
+                    break
+                os.remove(self._segment_path(segment))
+    
+    def _normalize(self, position):
+        """Map the end of a completed segment to the start of the next one"""
+        segment, offset = position
+        while segment < self.write_segment:
+            try:
+                if os.path.getsize(self._segment_path(segment)) > offset:
+                    break
+            except FileNotFoundError:
+                pass
+            segment, offset = segment + 1, 0
+        return (segment, offset)
+    
+    def has_unread(self):
+        """True if there are records that have not been handed out for replay yet"""
+        with self.lock:
+            return self._normalize(self.read_pos) != (self.write_segment, self.write_file.tell())
+    
+    def rewind(self):
+        """Restart replay from the first unacknowledged record"""
+        with self.lock:
+            self.read_pos = self.commit_pos
+    
+    def _write_cursor(self, position):
+        tmp_file = self.cursor_file + '.tmp'
+        with open(tmp_file, 'w') as f:
+            f.write(f"{position[0]} {position[1]}")
+            f.flush()
+            os.fsync(f.fileno())
+        os.replace(tmp_file, self.cursor_file)
+        self.commit_pos = position
+    
+    def close(self):
+        with self.lock:
+            self._maybe_sync(force=True)
+            self.write_file.close()
+    
+    def get_stats(self):
+        with self.lock:
+            return {
+                'journal_backlog': self.commit_pos != (self.write_segment, self.write_file.tell()),
+                'journal_bytes': self._size_on_disk(),
+                'journal_appended': self.appended,
+                'journal_discarded': self.discarded
+            }
+
+class DeliveryChannel:
+    """Ordered, windowed delivery of sequenced events to the collector.
+
+    Every event gets the next device sequence number when it leaves the
+    sender thread, so sequence order is also capture order and per-pin order.
+    Up to window events may be in flight at once; the collector confirms them
+    with {"type": "ack", "ack": n, "sack": [[lo, hi], ...]} where ack is
+    cumulative and sack lists further received ranges. Unacknowledged events
+    are retransmitted, in sequence order, only when a new session has been
+    established, and events the server reports as received in its welcome
+    are never resent.
+
+    Events that cannot be delivered go to the journal. When that happens the
+    live events still in flight are spilled to the journal first, so the
+    journal always holds a contiguous, ordered tail of the stream.
+    """
+    def __init__(self, session, journal, network_manager, sequence, window=64,
+                 ack_timeout=10.0, max_batch=50, replay_batch=500, legacy_sender=None):
+        self.session = session
+        self.journal = journal
+        self.network_manager = network_manager
+        self.sequence = sequence
+        self.window = max(1, window)
+        self.ack_timeout = ack_timeout
+        self.max_batch = max(1, max_batch)
+        self.replay_batch = max(1, replay_batch)
+        self.legacy_sender = legacy_sender
+        self.restored_notice = None  # callable building the event sent after an outage
+        self.ack_listeners = []  # callables given the acknowledged events (reader thread)
+        
+        self.cond = threading.Condition()
+        self.inflight = OrderedDict()  # seq -> {'data', 'position', 'sent_at'}
+        self.journal_positions = deque()  # (seq, journal position) of replayed events
+        self.generation = 0
+        # Failures are numbered rather than flagged: any thread may report one,
+        # and one reported while a notice is in flight is not lost
+        self.failure_counter = itertools.count(1)
+        self.failure_epoch = 0
+        self.notified_epoch = 0
+        
+        # Statistics
+        self.frames_sent = 0
+        self.events_acked = 0
+        self.retransmitted = 0
+        self.ack_rtt_total = 0.0
+        self.ack_rtt_max = 0.0
+        self.recent_sends = deque(maxlen=200)  # read by the local query endpoint
+        
+        session.on_message = self.on_message
+    
+    def note_failure(self):
+        """Record that events were lost or delayed (safe from any thread)"""
+        self.failure_epoch = next(self.failure_counter)
+    
+    def deliver(self, batch):
+        """Send or journal a batch of new events (sender thread only)"""
+        if self.journal and self.journal.has_backlog():
+            # Older events are journaled; new ones have to queue behind them
+            self.store(batch)
+            self.pump()
+            return
+        
+        if not self.ready():
+            self.mark_failed()
+            self.store(batch)
+            return
+        
+        start = 0
+        while start < len(batch):
+            chunk = batch[start:start + self.max_batch]
+            accepted = self.transmit(chunk)
+            start += accepted
+            if accepted < len(chunk):
+                logger.warning(f"Failed to send {len(batch) - start} pin events to server")
+                self.mark_failed()
+                self.store(batch[start:])
+                return
+    
+    def pump(self):
+        """Commit acknowledged journal records and replay the backlog (sender thread only)"""
+        self.commit_journal()
+        with self.cond:
+            pending = bool(self.inflight)
+        unread = self.journal is not None and self.journal.has_unread()
+        if not (pending or unread):
+            return
+        
+        if not self.ready():
+            if pending and not self.network_manager.is_connected:
+                # Don't keep undelivered live events only in memory during an outage
+                self.mark_failed()
+            return
+        
+        replayed = 0
+        while self.journal and self.journal.has_unread():
+            with self.cond:
+                room = self.window - len(self.inflight)
+            if room <= 0:
+                if not self.wait_for_room(1):
+                    break
+                continue
+            
+            records = self.journal.read_batch(min(room, self.replay_batch))
+            if not records:
+                break
+            
+            # Skip anything the server already confirmed (e.g. ack arrived just before a crash)
+            delivered = self.session.welcome.get('ack', 0) if not self.legacy_sender else 0
+            events = []
+            with self.cond:
+                for data, position in records:
+                    self.journal_positions.append((data['seq'], position))
+                    if data['seq'] > delivered:
+                        events.append(data)
+            
+            accepted = self.transmit(events, from_journal=True)
+            replayed += accepted
+            self.commit_journal()
+            if accepted < len(events):
+                self.mark_failed()
+                break
+        
+        if replayed:
+            logger.info(f"Replayed {replayed} journaled events")
+    
+    def ready(self):
+        """Make sure a session is open; retransmit unacknowledged events on a new one"""
+        if not self.network_manager.is_connected:
+            return False
+        if self.legacy_sender:
+            return self.send_restored_notice()
+        
+        self.check_ack_timeout()
+        if not self.session.connect():
+            return False
+        
+        if self.session.generation != self.generation:
+            self.generation = self.session.generation
+            self.apply_ack(self.session.welcome.get('ack', 0), [])
+            with self.cond:
+                pending = list(self.inflight.items())
+            if pending:
+                logger.info(f"Retransmitting {len(pending)} unacknowledged events")
+                self.retransmitted += len(pending)
+                for start in range(0, len(pending), self.replay_batch):
+                    if not self.send_batch(pending[start:start + self.replay_batch]):
+                        return False
+        
+        return self.send_restored_notice()
+    
+    def send_restored_notice(self):
+        """After an outage, tell the server before any further data is sent.
+
+        The notice is an unsequenced control frame so it cannot overtake or
+        be confused with journaled events still waiting for replay.
+        """
+        epoch = self.failure_epoch
+        if epoch <= self.notified_epoch:
+            return True
+        if self.restored_notice is None:
+            self.notified_epoch = epoch
+            return True
+        
+        notice = self.restored_notice()
+        if self.legacy_sender:
+            sent = self.legacy_sender(notice)
+        else:
+            try:
+                self.session.send_frame(json.dumps({'type': 'notice', 'event': notice}).encode('utf-8'),
+                                        acked=False)
+                sent = True
+            except OSError:
+                sent = False
+        
+        if sent:
+            logger.info("Sent connectivity restoration notice to server")
+            self.notified_epoch = epoch
+            return True
+        logger.warning("Failed to send connectivity restoration notice")
+        return False
+    
+    def mark_failed(self):
+        self.note_failure()
+        self.network_manager.note_suspect()
+        self.spill()
+    
+    def transmit(self, events, from_journal=False):
+        """Sequence and send events within the window; returns how many were accepted"""
+        if not events:
+            return 0
+        
+        if self.legacy_sender:
+            return self.transmit_legacy(events, from_journal)
+        
+        if not self.wait_for_room(len(events)):
+            return 0
+        
+        now = time.monotonic()
+        entries = []
+        with self.cond:
+            for data in events:
+                if 'seq' not in data:
+                    data['seq'] = self.sequence.next()
+                entry = {'data': data, 'position': from_journal, 'sent_at': now}
+                self.inflight[data['seq']] = entry
+                entries.append((data['seq'], entry))
+        
+        if self.send_batch(entries):
+            return len(events)
+        if self.session.is_open() and self.ready():
+            # Another uplink took over and the window was retransmitted on it
+            return len(events)
+        if from_journal:
+            # Still journaled: retransmitted from the window once a session opens
+            return 0
+        # Nothing carries these events: hand them back for the caller to journal
+        with self.cond:
+            for seq, entry in entries:
+                self.inflight.pop(seq, None)
+        return 0
+    
+    def transmit_legacy(self, events, from_journal):
+        """Legacy collectors answer each event on its own connection"""
+        with self.cond:
+            for data in events:
+                if 'seq' not in data:
+                    data['seq'] = self.sequence.next()
+                self.inflight[data['seq']] = {'data': data, 'position': from_journal,
+                                              'sent_at': time.monotonic()}
+        
+        for sent, data in enumerate(events):
+            if not self.legacy_sender(data):
+                self.note_send(data['seq'], data['seq'], 1, None, False)
+                break
+            self.note_send(data['seq'], data['seq'], 1, None, True)
+            with self.cond:
+                self.inflight.pop(data['seq'])
+                self.events_acked += 1
+            for listener in self.ack_listeners:
+                listener([data])
+        else:
+            return len(events)
+        
+        if from_journal:
+            # Unsent journal records are simply read again on the next replay
+            self.commit_journal()
+            with self.cond:
+                for data in events[sent:]:
+                    self.inflight.pop(data['seq'], None)
+                self.journal_positions.clear()
+            self.journal.rewind()
+            return sent
+        
+        with self.cond:
+            for data in events[sent:]:
+                self.inflight.pop(data['seq'], None)
+        return sent
+    
+    def send_batch(self, entries):
+        """Write one batch frame for (seq, entry) pairs"""
+        with self.cond:
+            base = min(self.inflight, default=entries[0][0])
+        now = time.monotonic()
+        for seq, entry in entries:
+            entry['sent_at'] = now
+        
+        payload = encode_batch(self.session.encoding, self.session.device_name, base,
+                               [entry['data'] for seq, entry in entries])
+        try:
+            self.session.send_frame(payload)
+            self.frames_sent += 1
+            logger.debug(f"Sent batch of {len(entries)} events (seq {entries[0][0]}-{entries[-1][0]})")
+            sent = True
+        except OSError as e:
+            logger.error(f"Error sending data to server {self.session.server_ip}:{self.session.server_port}: {e}")
+            sent = False
+        self.note_send(entries[0][0], entries[-1][0], len(entries), len(payload), sent)
+        return sent
+    
+    def note_send(self, first_seq, last_seq, events, size, sent):
+        self.recent_sends.append({'ts_ms': time.time_ns() // 1_000_000, 'seq': [first_seq, last_seq],
+                                  'events': events, 'bytes': size, 'sent': sent})
+    
+    def wait_for_room(self, count):
+        """Block until count more events fit in the window; False if the session died"""
+        count = min(count, self.window)
+        generation = self.session.generation
+        with self.cond:
+            while len(self.inflight) + count > self.window:
+                if not self.session.is_open() or self.session.generation != generation:
+                    return False
+                if self.ack_timed_out():
+                    break
+                self.cond.wait(0.1)
+            else:
+                return self.session.is_open()
+        
+        logger.warning(f"No acknowledgement from server within {self.ack_timeout} seconds, resetting session")
+        self.session.reset()
+        return False
+    
+    def ack_timed_out(self):
+        if not self.inflight:
+            return False
+        oldest = next(iter(self.inflight.values()))
+        return time.monotonic() - oldest['sent_at'] > self.ack_timeout
+    
+    def check_ack_timeout(self):
+        with self.cond:
+            timed_out = self.ack_timed_out()
+        if timed_out and self.session.is_open():
+            logger.warning(f"No acknowledgement from server within {self.ack_timeout} seconds, resetting session")
+            self.session.reset()
+    
+    def on_message(self, message):
+        """Handle a message from the server (session reader thread)"""
+        if message.get('type') == 'ack':
+            self.apply_ack(message.get('ack', 0), message.get('sack', []))
+        else:
+            logger.warning(f"Unexpected message from server: {message}")
+    
+    def apply_ack(self, ack, sack):
+        now = time.monotonic()
+        confirmed = []
+        with self.cond:
+            acked = [seq for seq in self.inflight if seq <= ack]
+            for lo, hi in sack:
+                acked.extend(seq for seq in self.inflight if lo <= seq <= hi)
+            for seq in acked:
+                entry = self.inflight.pop(seq, None)
+                if entry is None:
+                    continue
+                confirmed.append(entry['data'])
+                rtt = now - entry['sent_at']
+                self.events_acked += 1
+                self.ack_rtt_total += rtt
+                if rtt > self.ack_rtt_max:
+                    self.ack_rtt_max = rtt
+            if acked:
+                self.cond.notify_all()
+        
+        if confirmed:
+            for listener in self.ack_listeners:
+                listener(confirmed)
+    
+    def commit_journal(self):
+        """Advance the journal cursor past replayed events that are fully acknowledged"""
+        if not self.journal:
+            return
+        position = None
+        with self.cond:
+            while self.journal_positions and self.journal_positions[0][0] not in self.inflight:
+                position = self.journal_positions.popleft()[1]
+        if position:
+            self.journal.commit(position)
+    
+    def spill(self):
+        """Move live in-flight events to the journal ahead of anything newer"""
+        with self.cond:
+            live = [seq for seq, entry in self.inflight.items() if not entry['position']]
+            spilled = [self.inflight.pop(seq)['data'] for seq in live]
+        if spilled:
+            logger.info(f"Moving {len(spilled)} unacknowledged events to the journal")
+            self.store(spilled)
+    
+    def store(self, batch):
+        """Journal events for later replay"""
+        for data in batch:
+            if 'seq' not in data:
+                data['seq'] = self.sequence.next()
+            
+            if self.journal is None:
+                logger.warning(f"Pin {data['pin']} data lost - no network connection")
+                continue
+            
+            try:
+                self.journal.append(data)
+                logger.info(f"Pin {data['pin']} data journaled for later delivery")
+            except OSError as e:
+                logger.error(f"Pin {data['pin']} data lost - journal write failed: {e}")
+    
+    def get_stats(self):
+        with self.cond:
+            avg = self.ack_rtt_total / self.events_acked if self.events_acked else 0.0
+            return {
+                'inflight': len(self.inflight),
+                'window': self.window,
+                'frames_sent': self.frames_sent,
+                'events_acked': self.events_acked,
+                'retransmitted': self.retransmitted,
+                'ack_rtt_avg_ms': round(avg * 1000, 3),
+                'ack_rtt_max_ms': round(self.ack_rtt_max * 1000, 3)
+            }
+
+class SessionSet:
+    """Independent sessions to several collectors, opened and closed together"""
+    def __init__(self, sessions):
+        self.sessions = sessions
+    
+    @property
+    def on_lost(self):
+        return self.sessions[0].on_lost
+    
+    @on_lost.setter
+    def on_lost(self, callback):
+        for session in self.sessions:
+            session.on_lost = callback
+    
+    def is_open(self):
+        return any(session.is_open() for session in self.sessions)
+    
+    def connect(self):
+        opened = [session.connect() for session in self.sessions]
+        return any(opened)
+    
+    def close(self):
+        for session in self.sessions:
+            session.close()
+
+class FanoutChannel:
+    """Delivers every event to several collectors, each through its own queue.
+
+    Each destination has its own DeliveryChannel, journal and sender thread,
+    so a collector that is down or slow only backs up its own queue and
+    journal while the others keep receiving events as they happen. Sequence
+    numbers are assigned once, before the copies are made, so every
+    collector receives the same numbered stream. Ack listeners are shared
+    and called once per destination.
+    
+    A destination's journal has to stay in sequence order: the collector
+    takes the lowest sequence number in flight as a promise that nothing
+    below it is still to come. So when a destination's queue is full, its
+    events wait in an overflow list, and everything newer follows them
+    there, until its sender thread has handled all it had queued and
+    delivers (or journals) the overflow itself.
+    """
+    def __init__(self, destinations, sequence, queue_size=1000, linger=0.005, max_batch=50):
+        self.destinations = destinations  # (name, DeliveryChannel, EventJournal or None)
+        self.sequence = sequence
+        self.ack_listeners = []
+        self.pipelines = []
+        self.overflows = [deque() for destination in destinations]
+        self.overflow_lock = threading.Lock()
+        for index, (name, channel, journal) in enumerate(destinations):
+            channel.ack_listeners = self.ack_listeners
+            pipeline = SenderPipeline(lambda batch, index=index: self.handle(index, batch), queue_size,
+                                      idle_handler=lambda index=index: self.idle(index),
+                                      linger=linger, max_batch=max_batch)
+            if isinstance(channel.session, MultipathSession):
+                channel.session.on_switch = pipeline.poke
+            pipeline.start()
+            self.pipelines.append(pipeline)
+    
+    @property
+    def restored_notice(self):
+        return self.destinations[0][1].restored_notice
+    
+    @restored_notice.setter
+    def restored_notice(self, builder):
+        for name, channel, journal in self.destinations:
+            channel.restored_notice = builder
+    
+    @property
+    def recent_sends(self):
+        return self.destinations[0][1].recent_sends
+    
+    @recent_sends.setter
+    def recent_sends(self, sends):
+        for name, channel, journal in self.destinations:
+            channel.recent_sends = sends
+    
+    def note_failure(self):
+        for name, channel, journal in self.destinations:
+            channel.note_failure()
+    
+    def deliver(self, batch):
+        """Queue a copy of each event for every destination (sender thread)"""
+        for data in batch:
+            if 'seq' not in data:
+                data['seq'] = self.sequence.next()
+        with self.overflow_lock:
+            for (name, channel, journal), pipeline, overflow in zip(self.destinations, self.pipelines,
+                                                                    self.overflows):
+                for data in batch:
+                    copy = dict(data)
+                    if overflow or not pipeline.submit(copy):
+                        if not overflow:
+                            logger.warning(f"Queue for collector {name} full, holding its events until it catches up")
+                            channel.note_failure()
+                        copy.pop('enqueued_at', None)
+                        overflow.append(copy)
+    
+    def handle(self, index, batch):
+        """Deliver a batch, then any overflow it was the last queued event ahead of (destination's thread)"""
+        self.destinations[index][1].deliver(batch)
+        self.flush_overflow(index)
+    
+    def flush_overflow(self, index):
+        with self.overflow_lock:
+            overflow = self.overflows[index]
+            if not overflow or self.pipelines[index].queue.qsize():
+                # Events queued before the overflow go first
+                return
+            held = list(overflow)
+            overflow.clear()
+        logger.info(f"Collector {self.destinations[index][0]} caught up, delivering {len(held)} held events")
+        self.destinations[index][1].deliver(held)
+    
+    def pump(self):
+        """Nothing to do: every destination replays its journal on its own thread"""
+    
+    def idle(self, index):
+        name, channel, journal = self.destinations[index]
+        self.flush_overflow(index)
+        if journal:
+            journal.sync()
+        channel.pump()
+    
+    def close(self):
+        for pipeline in self.pipelines:
+            pipeline.stop()
+        for (name, channel, journal), overflow in zip(self.destinations, self.overflows):
+            # The sender threads are gone: keep unacknowledged and held events, in
+            # sequence order, for the next start
+            channel.spill()
+            if overflow:
+                channel.store(list(overflow))
+                overflow.clear()
+        for name, channel, journal in self.destinations:
+            if journal:
+                journal.close()
+    
+    def get_stats(self):
+        destinations = {}
+        for (name, channel, journal), pipeline, overflow in zip(self.destinations, self.pipelines, self.overflows):
+            stats = channel.get_stats()
+            pipeline_stats = pipeline.get_stats()
+            stats.update(queue_depth=pipeline_stats['queue_depth'], queue_overflows=pipeline_stats['dropped'],
+                         held=len(overflow))
+            if journal:
+                stats.update(journal.get_stats())
+            if isinstance(channel.session, MultipathSession):
+                stats.update(channel.session.get_stats())
+            destinations[name] = stats
+        return {'destinations': destinations}
+
+class LinkMonitor:
+    """Tracks links, IPv4 addresses and default routes through rtnetlink.
+
+    One netlink socket subscribed to link, address and route changes
+    replaces forking `ip` every check: the kernel pushes each change as it
+    happens and a thread folds it into an in-memory view. After a receive
+    buffer overflow the view is rebuilt from a fresh dump at once; after a
+    link or address goes away or a link changes state, which makes the
+    kernel drop routes without announcing it, one dump RESYNC_DELAY later
+    covers the whole burst. on_change is called (from the monitor thread)
+    after every change that was applied.
+    """
+    RESYNC_DELAY = 1.0
+    RTMGRP_LINK = 0x1
+    RTMGRP_IPV4_IFADDR = 0x10
+    RTMGRP_IPV4_ROUTE = 0x40
+    NLMSG_ERROR, NLMSG_DONE = 2, 3
+    RTM_NEWLINK, RTM_DELLINK, RTM_GETLINK = 16, 17, 18
+    RTM_NEWADDR, RTM_DELADDR, RTM_GETADDR = 20, 21, 22
+    RTM_NEWROUTE, RTM_DELROUTE, RTM_GETROUTE = 24, 25, 26
+    NLM_F_REQUEST, NLM_F_DUMP = 0x1, 0x300
+    IFLA_IFNAME, IFLA_OPERSTATE = 3, 16
+    IFA_ADDRESS, IFA_LOCAL = 1, 2
+    RTA_DST, RTA_OIF, RTA_GATEWAY, RTA_PRIORITY, RTA_TABLE = 1, 4, 5, 6, 15
+    RT_TABLE_MAIN = 254
+    IFF_UP, IFF_RUNNING = 0x1, 0x40
+    IF_OPER_UNKNOWN, IF_OPER_UP = 0, 6
+    
+    NLMSGHDR = struct.Struct('=IHHII')  # length, type, flags, seq, pid
+    IFINFOMSG = struct.Struct('=BxHiII')  # family, type, index, flags, change
+    IFADDRMSG = struct.Struct('=BBBBI')  # family, prefix length, flags, scope, index
+    RTMSG = struct.Struct('=BBBBBBBBI')  # family, dst len, src len, tos, table, protocol, scope, type, flags
+    RTATTR = struct.Struct('=HH')  # length, type
+    
+    def __init__(self, on_change=None):
+        self.on_change = on_change
+        self.lock = threading.Lock()
+        self.links = {}  # ifindex -> {'name', 'up'}
+        self.addresses = {}  # ifindex -> set of IPv4 addresses
+        self.routes = {}  # (oif, gateway) -> metric, IPv4 default routes in the main table
+        self.events = 0
+        self.resyncs = 0
+        self.resync_due = None  # monotonic time of the next scheduled dump
+        
+        # Subscribe before dumping so no change between the two is missed
+        self.sock = socket.socket(socket.AF_NETLINK, socket.SOCK_RAW, socket.NETLINK_ROUTE)
+        self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 1024 * 1024)
+        self.sock.bind((0, self.RTMGRP_LINK | self.RTMGRP_IPV4_IFADDR | self.RTMGRP_IPV4_ROUTE))
+        self.resync()
+        
+        self.running = True
+        self.thread = threading.Thread(target=self.monitor_loop, name='netlink', daemon=True)
+        self.thread.start()
+    
+    def resync(self):
+        """Rebuild the view from a full dump of links, addresses and routes"""
+        links, addresses, routes = {}, {}, {}
+        with socket.socket(socket.AF_NETLINK, socket.SOCK_RAW, socket.NETLINK_ROUTE) as dump:
+            dump.bind((0, 0))
+            for seq, (msg_type, body) in enumerate(((self.RTM_GETLINK, self.IFINFOMSG.pack(0, 0, 0, 0, 0)),
+                                                    (self.RTM_GETADDR, self.IFADDRMSG.pack(socket.AF_INET, 0, 0, 0, 0)),
+                                                    (self.RTM_GETROUTE, self.RTMSG.pack(socket.AF_INET, 0, 0, 0, 0, 0, 0, 0, 0))), 1):
+                header = self.NLMSGHDR.pack(self.NLMSGHDR.size + len(body), msg_type,
+                                            self.NLM_F_REQUEST | self.NLM_F_DUMP, seq, 0)
+                dump.send(header + body)
+                done = False
+                while not done:
+                    for msg_type, payload in self.messages(dump.recv(65536)):
+                        if msg_type in (self.NLMSG_DONE, self.NLMSG_ERROR):
+                            done = True
+                            break
+                        self.apply(msg_type, payload, links, addresses, routes)
+        with self.lock:
+            self.links, self.addresses, self.routes = links, addresses, routes
+    
+    def messages(self, data):
+        offset = 0
+        while offset + self.NLMSGHDR.size <= len(data):
+            length, msg_type, flags, seq, pid = self.NLMSGHDR.unpack_from(data, offset)
+            if length < self.NLMSGHDR.size:
+                return
+            yield msg_type, data[offset + self.NLMSGHDR.size:offset + length]
+            offset += (length + 3) & ~3
+    
+    def attributes(self, data, offset):
+        attrs = {}
+        while offset + self.RTATTR.size <= len(data):
+            length, attr_type = self.RTATTR.unpack_from(data, offset)
+            if length < self.RTATTR.size:
+                break
+            attrs[attr_type] = data[offset + self.RTATTR.size:offset + length]
+            offset += (length + 3) & ~3
+        return attrs
+    
+    def apply(self, msg_type, payload, links, addresses, routes):
+        """Fold one rtnetlink message into the given view; returns True if it was relevant"""
+        if msg_type in (self.RTM_NEWLINK, self.RTM_DELLINK):
+            family, _, index, flags, _ = self.IFINFOMSG.unpack_from(payload)
+            if msg_type == self.RTM_DELLINK:
+                links.pop(index, None)
+                addresses.pop(index, None)
+                return True
+            attrs = self.attributes(payload, self.IFINFOMSG.size)
+            operstate = attrs[self.IFLA_OPERSTATE][0] if self.IFLA_OPERSTATE in attrs else self.IF_OPER_UNKNOWN
+            # Same notion as "state UP" in ip addr show; drivers without operstate fall back to RUNNING
+            up = bool(flags & self.IFF_UP) and (operstate == self.IF_OPER_UP or
+                                                (operstate == self.IF_OPER_UNKNOWN and bool(flags & self.IFF_RUNNING)))
+            name = attrs.get(self.IFLA_IFNAME, b'').rstrip(b'\0').decode(errors='replace')
+            previous = links.get(index)
+            links[index] = {'name': name or (previous or {}).get('name', ''), 'up': up}
+            # Wireless drivers announce statistics and scan results the same way
+            return links[index] != previous
+        
+        if msg_type in (self.RTM_NEWADDR, self.RTM_DELADDR):
+            family, _, _, _, index = self.IFADDRMSG.unpack_from(payload)
+            if family != socket.AF_INET:
+                return False
+            attrs = self.attributes(payload, self.IFADDRMSG.size)
+            raw = attrs.get(self.IFA_LOCAL) or attrs.get(self.IFA_ADDRESS)
+            if not raw:
+                return False
+            address = socket.inet_ntoa(raw[:4])
+            if msg_type == self.RTM_NEWADDR:
+                addresses.setdefault(index, set()).add(address)
+            else:
+                addresses.get(index, set()).discard(address)
+            return True
+        
+        if msg_type in (self.RTM_NEWROUTE, self.RTM_DELROUTE):
+            family, dst_len, _, _, table, _, _, _, _ = self.RTMSG.unpack_from(payload)
+            attrs = self.attributes(payload, self.RTMSG.size)
+            if self.RTA_TABLE in attrs:
+                table = struct.unpack('=I', attrs[self.RTA_TABLE][:4])[0]
+            if family != socket.AF_INET or dst_len != 0 or table != self.RT_TABLE_MAIN:
+                return False
+            gateway = socket.inet_ntoa(attrs[self.RTA_GATEWAY][:4]) if self.RTA_GATEWAY in attrs else None
+            oif = struct.unpack('=I', attrs[self.RTA_OIF][:4])[0] if self.RTA_OIF in attrs else 0
+            metric = struct.unpack('=I', attrs[self.RTA_PRIORITY][:4])[0] if self.RTA_PRIORITY in attrs else 0
+            if msg_type == self.RTM_NEWROUTE:
+                routes[(oif, gateway)] = metric
+            else:
+                routes.pop((oif, gateway), None)
+            return True
+        return False
+    
+    def monitor_loop(self):
+        while self.running:
+            timeout = None
+            if self.resync_due is not None:
+                timeout = self.resync_due - time.monotonic()
+                if timeout <= 0:
+                    self.scheduled_resync()
+                    continue
+            try:
+                self.sock.settimeout(timeout)
+                data = self.sock.recv(65536)
+            except socket.timeout:
+                continue
+            except OSError as e:
+                if not self.running:
+                    return
+                if e.errno == errno.ENOBUFS:
+                    # Changes were dropped; the incremental view can't be trusted
+                    logger.warning("Netlink receive buffer overflowed, resynchronizing link state")
+                    self.resync_due = 0
+                    continue
+                logger.error(f"Netlink receive failed: {e}")
+                time.sleep(1)
+                continue
+            
+            changed = False
+            flushed = False
+            with self.lock:
+                for msg_type, payload in self.messages(data):
+                    relevant = self.apply(msg_type, payload, self.links, self.addresses, self.routes)
+                    changed |= relevant
+                    flushed |= relevant and msg_type in (self.RTM_DELLINK, self.RTM_DELADDR, self.RTM_NEWLINK)
+            if flushed and self.resync_due is None:
+                # The kernel drops routes with their link or address without announcing it
+                self.resync_due = time.monotonic() + self.RESYNC_DELAY
+            if changed:
+                self.events += 1
+                self.notify()
+    
+    def scheduled_resync(self):
+        try:
+            self.resync()
+        except OSError as e:
+            logger.warning(f"Netlink resync failed ({e}), retrying in {self.RESYNC_DELAY} seconds")
+            self.resync_due = time.monotonic() + self.RESYNC_DELAY
+            return
+        self.resync_due = None
+        self.resyncs += 1
+        self.notify()
+    
+    def notify(self):
+        if self.on_change:
+            try:
+                self.on_change()
+            except Exception as e:
+                logger.error(f"Error in link change handler: {e}")
+    
+    def index_of(self, interface):
+        for index, link in self.links.items():
+            if link['name'] == interface:
+                return index
+        return None
+    
+    def interface_up(self, interface):
+        """True if the interface is operationally up and has an IPv4 address"""
+        with self.lock:
+            index = self.index_of(interface)
+            return index is not None and self.links[index]['up'] and bool(self.addresses.get(index))
+    
+    def interface_address(self, interface):
+        """One of the interface's IPv4 addresses, or None"""
+        with self.lock:
+            addresses = self.addresses.get(self.index_of(interface))
+            return min(addresses) if addresses else None
+    
+    def default_gateway(self):
+        """Gateway of the preferred IPv4 default route whose interface is up, or None"""
+        with self.lock:
+            usable = [(metric, gateway) for (oif, gateway), metric in self.routes.items()
+                      if gateway and self.links.get(oif, {}).get('up')]
+        return min(usable)[1] if usable else None
+    
+    def close(self):
+        self.running = False
+        self.sock.close()
+    
+    def get_stats(self):
+        return {'netlink_events': self.events, 'netlink_resyncs': self.resyncs}
+
+class ReachabilityProber:
+    """In-process reachability probes, run concurrently under one deadline.
+
+    ICMP echo uses an unprivileged datagram socket (allowed for the groups in
+    net.ipv4.ping_group_range). Where that isn't permitted, a TCP connect to
+    tcp_port is used instead; a refused connection still proves the host
+    answered. All probes of a round share one epoll wait, so a round never
+    takes longer than its timeout however many targets it has.
+    """
+    ICMP_ECHO_REQUEST = 8
+    ICMP_ECHO_REPLY = 0
+    ICMP_HEADER = struct.Struct('!BBHHH')  # type, code, checksum, id, sequence
+    ICMP_PAYLOAD = b'gpio_monitor'
+    RTT_SMOOTHING = 0.2
+    
+    def __init__(self, tcp_port=80):
+        self.tcp_port = tcp_port
+        self.icmp_allowed = True
+        self.sequence = itertools.count(1)
+        self.lock = threading.Lock()
+        self.targets = {}  # name -> per-target statistics
+    
+    def open_icmp(self, host):
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_ICMP)
+        sock.setblocking(False)
+        sequence = next(self.sequence) & 0xFFFF
+        # The kernel fills in the identifier and checksum on ping sockets
+        sock.sendto(self.ICMP_HEADER.pack(self.ICMP_ECHO_REQUEST, 0, 0, 0, sequence) + self.ICMP_PAYLOAD,
+                    (host, 0))
+        return sock, sequence
+    
+    def open_tcp(self, host, port):
+        sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        sock.setblocking(False)
+        return sock, sock.connect_ex((host, port))
+    
+    def probe(self, targets, timeout):
+        """Probe (name, method, host, port) targets; returns {name: rtt_ms or None}.
+
+        method is 'icmp' or 'tcp'; port is only used by TCP probes (and by
+        ICMP probes falling back to TCP, if given).
+        """
+        results = {name: None for name, method, host, port in targets}
+        deadline = time.monotonic() + timeout
+        epoll = select.epoll()
+        pending = {}  # fd -> (name, method, sock, sequence, sent_ns)
+        
+        try:
+            for name, method, host, port in targets:
+                sent_ns = time.monotonic_ns()
+                try:
+                    if method == 'icmp' and self.icmp_allowed:
+                        try:
+                            sock, sequence = self.open_icmp(host)
+                            pending[sock.fileno()] = (name, 'icmp', sock, sequence, sent_ns)
+                            epoll.register(sock.fileno(), select.EPOLLIN)
+                            continue
+                        except PermissionError:
+                            self.icmp_allowed = False
+                            logger.info(f"Unprivileged ICMP not permitted, probing with TCP port {port or self.tcp_port}")
+                    sock, err = self.open_tcp(host, port or self.tcp_port)
+                except OSError as e:
+                    logger.debug(f"Probe {name} ({host}) failed to start: {e}")
+                    continue
+                if err == errno.EINPROGRESS:
+                    pending[sock.fileno()] = (name, 'tcp', sock, None, sent_ns)
+                    epoll.register(sock.fileno(), select.EPOLLOUT)
+                else:
+                    if err in (0, errno.ECONNREFUSED):
+                        results[name] = (time.monotonic_ns() - sent_ns) / 1e6
+                    sock.close()
+            
+            while pending:
+                remaining = deadline - time.monotonic()
+                if remaining <= 0:
+                    break
+                for fd, mask in epoll.poll(remaining):
+                    name, method, sock, sequence, sent_ns = pending[fd]
+                    answered = False
+                    if method == 'icmp':
+                        try:
+                            reply = sock.recv(1024)
+                            reply_type, _, _, _, reply_sequence = self.ICMP_HEADER.unpack_from(reply)
+                            if reply_type != self.ICMP_ECHO_REPLY or reply_sequence != sequence:
+                                continue  # not our echo; keep waiting
+                            answered = True
+                        except (OSError, struct.error):
+                            pass  # e.g. ICMP unreachable reported as a socket error
+                    else:
+                        answered = sock.getsockopt(socket.SOL_SOCKET, socket.SO_ERROR) in (0, errno.ECONNREFUSED)
+                    if answered:
+                        results[name] = (time.monotonic_ns() - sent_ns) / 1e6
+                    epoll.unregister(fd)
+                    sock.close()
+                    del pending[fd]
+        finally:
+            for name, method, sock, sequence, sent_ns in pending.values():
+                sock.close()
+            epoll.close()
+        
+        self.record(results, targets)
+        return results
+    
+    def record(self, results, targets):
+        with self.lock:
+            for name, method, host, port in targets:
+                stats = self.targets.setdefault(name, {'host': host, 'ok': 0, 'failed': 0,
+                                                       'last_rtt_ms': None, 'avg_rtt_ms': None})
+                rtt = results[name]
+                if rtt is None:
+                    stats['failed'] += 1
+                    continue
+                stats['ok'] += 1
+                stats['last_rtt_ms'] = round(rtt, 3)
+                avg = stats['avg_rtt_ms']
+                stats['avg_rtt_ms'] = round(rtt if avg is None else avg + (rtt - avg) * self.RTT_SMOOTHING, 3)
+    
+    def get_stats(self):
+        with self.lock:
+            return {'probes': {name: dict(stats) for name, stats in self.targets.items()}}
+
+def collector_endpoints(config):
+    """Collector (host, port) pairs from [server] endpoints, else ip and port, in order of preference"""
+    endpoints = []
+    for item in filter(None, (item.strip() for item in config['server']['endpoints'].split(','))):
+        host, _, port = item.rpartition(':')
+        endpoints.append((host, int(port)) if host else (item, int(config['server']['port'])))
+    return endpoints or [(config['server']['ip'], int(config['server']['port']))]
+
+class LatencyHistogram:
+    """Counts of durations in fixed buckets of milliseconds, roughly logarithmic.
+
+    Recording is one bisect and a few additions, so it stays on for every
+    frame; percentiles come back at bucket resolution, as the bucket's
+    upper bound.
+    """
+    BOUNDS_MS = (0.5, 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000)
+    
+    def __init__(self):
+        self.counts = [0] * (len(self.BOUNDS_MS) + 1)
+        self.count = 0
+        self.total_ms = 0.0
+        self.max_ms = 0.0
+    
+    def record(self, seconds):
+        ms = seconds * 1000
+        self.counts[bisect.bisect_left(self.BOUNDS_MS, ms)] += 1
+        self.count += 1
+        self.total_ms += ms
+        if ms > self.max_ms:
+            self.max_ms = ms
+    
+    def percentile(self, fraction):
+        rank = fraction * self.count
+        seen = 0
+        for bucket, count in enumerate(self.counts):
+            seen += count
+            if seen >= rank:
+                return self.BOUNDS_MS[bucket] if bucket < len(self.BOUNDS_MS) else round(self.max_ms, 3)
+        return None
+    
+    def snapshot(self):
+        if not self.count:
+            return {'count': 0}
+        buckets = {f"le_{bound}": count for bound, count in zip(self.BOUNDS_MS, self.counts) if count}
+        if self.counts[-1]:
+            buckets[f"gt_{self.BOUNDS_MS[-1]}"] = self.counts[-1]
+        return {'count': self.count,
+                'mean_ms': round(self.total_ms / self.count, 3),
+                'max_ms': round(self.max_ms, 3),
+                'p50_ms': self.percentile(0.5),
+                'p90_ms': self.percentile(0.9),
+                'p99_ms': self.percentile(0.99),
+                'buckets': buckets}
+
+class NetworkMetrics:
+    """Always-on measurements of the network, served at /network.
+
+    Per collector path (ServerSession name): histograms of TCP connect time,
+    time to write a frame, and acknowledgement round trip (oldest unanswered
+    frame to the next server message). Per interface: link flaps, counted
+    as transitions from usable (up with an address) to not. Per outage: when
+    it started, how long it lasted, how many recovery actions ran and which
+    remediation step ran last before connectivity returned - the one that
+    fixed it, or 'none' when the network came back on its own.
+    """
+    KINDS = ('connect', 'send', 'ack')
+    HISTORY = 50  # outage episodes kept
+    
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.paths = {}  # path name -> {kind: LatencyHistogram}
+        self.links = {}  # interface -> {'up': bool, 'flaps': int, 'changed': monotonic time}
+        self.outage = None  # episode in progress
+        self.outages = 0
+        self.disconnected_total = 0.0
+        self.episodes = deque(maxlen=self.HISTORY)
+        self.fixed_by = {}  # remediation step (or 'none') -> outages it ended
+    
+    def record(self, path, kind, seconds):
+        with self.lock:
+            histograms = self.paths.get(path)
+            if histograms is None:
+                histograms = self.paths[path] = {k: LatencyHistogram() for k in self.KINDS}
+            histograms[kind].record(seconds)
+    
+    def link_state(self, interface, up):
+        with self.lock:
+            link = self.links.get(interface)
+            if link is None:
+                self.links[interface] = {'up': up, 'flaps': 0, 'changed': time.monotonic()}
+            elif link['up'] != up:
+                link['up'] = up
+                link['changed'] = time.monotonic()
+                if not up:
+                    link['flaps'] += 1
+    
+    def outage_started(self):
+        with self.lock:
+            if self.outage is None:
+                self.outage = {'ts_ms': int(time.time() * 1000), 'started': time.monotonic(),
+                               'actions': 0, 'step': None}
+    
+    def action_run(self, step):
+        with self.lock:
+            if self.outage is not None:
+                self.outage['actions'] += 1
+                self.outage['step'] = step
+    
+    def outage_ended(self, reason, rounds):
+        with self.lock:
+            outage, self.outage = self.outage, None
+            if outage is None:
+                return
+            duration = time.monotonic() - outage['started']
+            fixed_by = outage['step'] or 'none'
+            self.outages += 1
+            self.disconnected_total += duration
+            self.fixed_by[fixed_by] = self.fixed_by.get(fixed_by, 0) + 1
+            self.episodes.append({'ts_ms': outage['ts_ms'], 'duration_sec': round(duration, 3),
+                                  'actions': outage['actions'], 'rounds': rounds,
+                                  'fixed_by': fixed_by, 'recovered': reason})
+    
+    def disconnected_sec(self, now):
+        ongoing = now - self.outage['started'] if self.outage else 0.0
+        return self.disconnected_total + ongoing
+    
+    def summary(self):
+        """Scalars for the periodic stats line"""
+        with self.lock:
+            return {'disconnected_sec': round(self.disconnected_sec(time.monotonic()), 1),
+                    'outages': self.outages,
+                    'link_flaps': sum(link['flaps'] for link in self.links.values())}
+    
+    def snapshot(self):
+        now = time.monotonic()
+        with self.lock:
+            return {
+                'paths': {name: {kind: histogram.snapshot() for kind, histogram in histograms.items()}
+                          for name, histograms in self.paths.items()},
+                'links': {interface: {'up': link['up'], 'flaps': link['flaps'],
+                                      'since_sec': round(now - link['changed'], 1)}
+                          for interface, link in self.links.items()},
+                'disconnected_sec': round(self.disconnected_sec(now), 3),
+                'outage_sec': round(now - self.outage['started'], 3) if self.outage else None,
+                'outages': self.outages,
+                'fixed_by': dict(self.fixed_by),
+                'episodes': list(self.episodes)
+            }
+
 class NetworkManager:
+    CONNECTED = 'connected'
+    REMEDIATING = 'remediating'
+    BACKOFF = 'backoff'
+    ACTION_TIMEOUT = 30  # seconds a recovery command may run before it is killed
+    
     def __init__(self, config):
         self.config = config
         self.wifi_interface = config['network']['wifi_interface']
         self.ethernet_interface = config['network']['ethernet_interface']
-        self.server_ip = config['server']['ip']
-        self.server_port = int(config['server']['port'])
+        self.uplinks = [name.strip() for name in config['network']['uplinks'].split(',') if name.strip()]
+        self.interfaces = list(OrderedDict.fromkeys([self.wifi_interface, self.ethernet_interface] + self.uplinks))
+        self.metrics = NetworkMetrics()
+        self.endpoints = collector_endpoints(config)
+        self.server_ip, self.server_port = self.endpoints[0]
+        self.collectors_down = False
         self.check_interval = int(config['network']['check_interval'])
+        self.check_interval_max = max(self.check_interval, int(config['network']['check_interval_max']))
+        self.probe_interval = self.check_interval  # idle time before an active check, adapted to stability
+        self.session = None  # live collector session, if any; while open it stands in for the server probe
+        self.last_healthy = 0  # monotonic time of the last ack or successful check
+        self.passive_checks = 0
+        self.active_checks = 0
         self.reconnect_timeout = int(config['network']['reconnect_timeout'])
         self.gateway_check = config['network']['gateway_check'].lower() == 'true'
         self.server_check = config['network']['server_check'].lower() == 'true'
-        self.is_connected = False
-        self.last_check_time = 0
+        self.connectivity_listeners = []
+        self.link_listeners = []  # callables run (netlink thread) after every link, address or route change
+        self._is_connected = False
         self.gateway_ip = None
+        self.wake = threading.Event()  # set when a link change wants an immediate check
+        self.backoff_min = float(config['network']['reconnect_backoff_min'])
+        self.backoff_max = float(config['network']['reconnect_backoff_max'])
+        self.state = self.CONNECTED
+        self.next_due = 0  # monotonic time of the next step; 0 means now
+        self.plan = deque()
+        self.action = None  # (process, description, deadline) of the recovery command last started
+        self.attempt = 0
+        self.outage_started = 0
+        self.gave_up = False
+        self.healthy_reason = None  # what vouched for the server at last_healthy
+        self.step_lock = threading.Lock()
+        # Requests for an immediate probe are numbered, like delivery failures,
+        # so one made while a probe is running is not lost
+        self.probe_counter = itertools.count(1)
+        self.probe_requested = 0
+        self.probe_handled = 0
+        self.probe_timeout = float(config['network']['probe_timeout'])
+        self.prober = ReachabilityProber(int(config['network']['probe_port']))
         
+        self.link_monitor = None
+        if config['network']['link_monitor'].lower() == 'netlink':
+            try:
+                self.link_monitor = LinkMonitor(on_change=self.on_link_change)
+            except OSError as e:
+                logger.warning(f"Netlink link monitoring unavailable ({e}), polling with ip instead")
+    
+    @property
+    def is_connected(self):
+        return self._is_connected
+    
+    @is_connected.setter
+    def is_connected(self, value):
+        changed = value != self._is_connected
+        self._is_connected = value
+        if changed:
+            for listener in self.connectivity_listeners:
+                try:
+                    listener(value)
+                except Exception as e:
+                    logger.error(f"Error in connectivity listener: {e}")
+    
+    def add_connectivity_listener(self, listener):
+        """Register a callable invoked with the new state whenever is_connected flips"""
+        self.connectivity_listeners.append(listener)
+        
+    def on_link_change(self):
+        """A link, address or route changed: react now rather than at the next check"""
+        self.track_links()
+        if not any(self.check_interface_status(interface) for interface in self.interfaces):
+            if self.is_connected:
+                logger.warning("No network interface is up")
+            self.is_connected = False
+        self.gateway_ip = None
+        for listener in self.link_listeners:
+            try:
+                listener()
+            except Exception as e:
+                logger.error(f"Error in link change listener: {e}")
+        self.request_probe()
+    
+    def track_links(self):
+        """Note which interfaces are usable, for the link flap counters"""
+        for interface in self.interfaces:
+            self.metrics.link_state(interface, self.check_interface_status(interface))
+    
+    def wait(self, timeout):
+        """Sleep until the next check is due or a link change wants one sooner"""
+        self.wake.wait(timeout)
+        self.wake.clear()
+    
     def check_interface_status(self, interface):
         """Check if a network interface is up and has an IP address"""
+        if self.link_monitor:
+            return self.link_monitor.interface_up(interface)
         try:
             result = subprocess.run(['ip', 'addr', 'show', interface], 
                                   capture_output=True, text=True, timeout=10)
@@ -90,253 +2212,1489 @@ class NetworkManager:
             logger.debug(f"Error checking interface {interface}: {e}")
             return False
     
-    def get_default_gateway(self):
-        """Get the default gateway IP address"""
-        try:
-            result = subprocess.run(['ip', 'route', 'show', 'default'], 
-                                  capture_output=True, text=True, timeout=10)
-            if result.returncode == 0:
-                output = result.stdout.strip()
-                # Parse "default via 192.168.1.1 dev wlan0" format
-                parts = output.split()
-                if len(parts) >= 3 and parts[0] == 'default' and parts[1] == 'via':
-                    return parts[2]
-            return None
-        except Exception as e:
-            logger.debug(f"Error getting default gateway: {e}")
-            return None
+    def interface_address(self, interface):
+        """An IPv4 address of the interface, or None"""
+        if self.link_monitor:
+            return self.link_monitor.interface_address(interface)
+        try:
+            result = subprocess.run(['ip', '-4', '-o', 'addr', 'show', 'dev', interface],
+                                  capture_output=True, text=True, timeout=10)
+            for line in result.stdout.splitlines():
+                fields = line.split()
+                if 'inet' in fields:
+                    return fields[fields.index('inet') + 1].split('/')[0]
+        except Exception as e:
+            logger.debug(f"Error reading address of {interface}: {e}")
+        return None
+    
+    def get_default_gateway(self):
+        """Get the default gateway IP address"""
+        if self.link_monitor:
+            return self.link_monitor.default_gateway()
+        try:
+            result = subprocess.run(['ip', 'route', 'show', 'default'], 
+                                  capture_output=True, text=True, timeout=10)
+            if result.returncode == 0:
+                output = result.stdout.strip()
+                # Parse "default via 192.168.1.1 dev wlan0" format
+                parts = output.split()
+                if len(parts) >= 3 and parts[0] == 'default' and parts[1] == 'via':
+                    return parts[2]
+            return None
+        except Exception as e:
+            logger.debug(f"Error getting default gateway: {e}")
+            return None
+    
+    def server_probes(self):
+        if len(self.endpoints) == 1:
+            return [('server', 'tcp', self.server_ip, self.server_port)]
+        return [(f"server {host}:{port}", 'tcp', host, port) for host, port in self.endpoints]
+    
+    def gateway_probe(self):
+        if not self.gateway_ip:
+            self.gateway_ip = self.get_default_gateway()
+            if not self.gateway_ip:
+                logger.debug("No default gateway found")
+                return None
+        return ('gateway', 'icmp', self.gateway_ip, None)
+    
+    def test_lan_connectivity(self):
+        """Test LAN connectivity using available methods, probing them all at once"""
+        probes = []
+        if self.server_check:
+            if self.session and self.session.is_open():
+                # Keepalive and the user timeout drop the session if the server stops answering
+                return True
+            probes.extend(self.server_probes())
+        if self.gateway_check:
+            probe = self.gateway_probe()
+            if probe:
+                probes.append(probe)
+        if not probes:
+            return False
+        
+        results = self.prober.probe(probes, self.probe_timeout)
+        
+        # Log test results
+        test_results = ', '.join(f"{name}: {'%.1f ms' % rtt if rtt is not None else 'failed'}"
+                                 for name, rtt in results.items())
+        logger.debug(f"Connectivity tests - {test_results}")
+        
+        # Any collector or the gateway answering means the LAN is up; collectors
+        # all being down (e.g. patched) is not fixed by restarting our interfaces
+        collectors_down = self.server_check and results.get('gateway') is not None and not any(
+            rtt is not None for name, rtt in results.items() if name != 'gateway')
+        if collectors_down != self.collectors_down:
+            self.collectors_down = collectors_down
+            if collectors_down:
+                logger.warning("No collector endpoint answers but the gateway does; waiting for the collectors")
+        return any(rtt is not None for rtt in results.values())
+    
+    def remediation_plan(self):
+        """Recovery actions for the interfaces that are down, in the order to try them.
+
+        Each action is (step, description, command, interface, settle): the
+        command is run once, then given up to settle seconds to take effect;
+        step names the kind of fix for the outage metrics. Actions tagged with
+        an interface are skipped if it has come up meanwhile.
+        """
+        plan = deque()
+        for interface, extra in ((self.wifi_interface, [('wpa_supplicant', 'restart wpa_supplicant',
+                                                        ['sudo', 'systemctl', 'restart', 'wpa_supplicant'], 15)]),
+                                 (self.ethernet_interface, [])):
+            if self.check_interface_status(interface):
+                continue
+            plan.append(('interface restart', f"bring {interface} down",
+                         ['sudo', 'ip', 'link', 'set', interface, 'down'], None, 2))
+            plan.append(('interface restart', f"bring {interface} up",
+                         ['sudo', 'ip', 'link', 'set', interface, 'up'], None, 5))
+            for step, description, command, settle in extra:
+                plan.append((step, description, command, interface, settle))
+            plan.append(('dhclient', f"release DHCP lease on {interface}",
+                         ['sudo', 'dhclient', '-r', interface], None, 2))
+            # -nw returns at once; the new address is reported by the link monitor
+            plan.append(('dhclient', f"renew DHCP lease on {interface}",
+                         ['sudo', 'dhclient', '-nw', interface], None, 10))
+        return plan
+    
+    def run_action(self, action):
+        """Start one recovery command in the background; returns the seconds to let it settle"""
+        step, description, command, interface, settle = action
+        if interface and self.check_interface_status(interface):
+            return 0
+        logger.info(f"Reconnection: {description}")
+        self.metrics.action_run(step)
+        try:
+            process = subprocess.Popen(command, stdin=subprocess.DEVNULL, stdout=subprocess.DEVNULL,
+                                       stderr=subprocess.DEVNULL)
+            self.action = (process, description, time.monotonic() + self.ACTION_TIMEOUT)
+        except OSError as e:
+            logger.error(f"Reconnection action '{description}' failed: {e}")
+        self.gateway_ip = None
+        return settle
+    
+    def action_running(self):
+        """True while the last recovery command runs; reaps it (killing it past its deadline) otherwise"""
+        if self.action is None:
+            return False
+        process, description, deadline = self.action
+        status = process.poll()
+        if status is None:
+            if time.monotonic() < deadline:
+                return True
+            process.kill()
+            process.wait()
+            logger.error(f"Reconnection action '{description}' killed after {self.ACTION_TIMEOUT} seconds")
+        elif status != 0:
+            logger.error(f"Reconnection action '{description}' failed with exit status {status}")
+        self.action = None
+        return False
+    
+    def backoff_delay(self):
+        """Exponential backoff with jitter between rounds of recovery actions"""
+        delay = min(self.backoff_max, self.backoff_min * 2 ** min(self.attempt, 16))
+        return random.uniform(delay / 2, delay)
+    
+    def note_healthy(self, reason):
+        """Another part of the client has proof the server is reachable (any thread).
+
+        Only the step decides, under step_lock, whether this ends an outage;
+        waking it early is harmless, so the state is read here without the lock.
+        """
+        self.healthy_reason = reason
+        self.last_healthy = time.monotonic()
+        if self.state != self.CONNECTED:
+            self.wake.set()
+    
+    def request_probe(self):
+        """Probe at the next step instead of waiting for the current deadline (any thread)"""
+        self.probe_requested = next(self.probe_counter)
+        self.wake.set()
+    
+    def note_suspect(self):
+        """Sending failed while believed connected: check now rather than at the next interval (any thread)"""
+        if self.state == self.CONNECTED and self.is_connected:
+            self.request_probe()
+    
+    def enter(self, state, due):
+        if state != self.state:
+            logger.debug(f"Connectivity state {self.state} -> {state}")
+            self.state = state
+        self.next_due = due
+    
+    def recovered(self, reason):
+        outage = time.monotonic() - self.outage_started
+        logger.info(f"LAN connectivity restored ({reason}) after {outage:.1f} seconds, "
+                    f"{self.attempt} backoff rounds")
+        self.metrics.outage_ended(reason, self.attempt)
+        self.gave_up = False
+        self.is_connected = True
+        self.enter(self.CONNECTED, time.monotonic() + self.probe_interval)
+    
+    def time_to_next_step(self):
+        return max(0.0, self.next_due - time.monotonic())
+    
+    def get_stats(self):
+        stats = {'network_state': self.state,
+                 'probe_interval': self.probe_interval,
+                 'passive_checks': self.passive_checks,
+                 'active_checks': self.active_checks}
+        stats.update(self.metrics.summary())
+        stats.update(self.prober.get_stats())
+        return stats
+    
+    def check_connectivity(self):
+        """Advance the connectivity state machine by one step; never blocks beyond a probe round"""
+        with self.step_lock:
+            return self.step()
+    
+    def step(self):
+        """One step of the connectivity state machine (under step_lock).
+
+        CONNECTED probes every check_interval. When that fails, REMEDIATING
+        runs one recovery action per step and waits for it to settle, and
+        once the plan is exhausted BACKOFF waits with exponential backoff and
+        jitter before the next round. Recovery commands run in the background:
+        the next action waits until the previous one has exited, or been
+        killed after ACTION_TIMEOUT, so a step itself never waits for one.
+        A link or address change, or an ack from the server, cuts any wait
+        short: the former triggers a probe at once, the latter counts as
+        recovery by itself.
+        
+        While connected, health is inferred from acknowledgements and the
+        kept-alive session; the active check only runs once the link has been
+        idle for probe_interval, which doubles with every check passed and
+        falls back to check_interval after an outage.
+        """
+        if self.state != self.CONNECTED and self.last_healthy > self.outage_started:
+            # Proof of reachability (an ack) arrived since the outage began
+            self.recovered(self.healthy_reason)
+            return self.is_connected
+        if self.state == self.CONNECTED:
+            # Reap a recovery command that outlived the outage it was started for
+            self.action_running()
+        
+        now = time.monotonic()
+        requested = self.probe_requested
+        if now < self.next_due and requested <= self.probe_handled:
+            return self.is_connected
+        forced = requested > self.probe_handled
+        self.probe_handled = requested
+        
+        if self.state == self.CONNECTED and self.is_connected and not forced:
+            if now - self.last_healthy < self.probe_interval:
+                # Traffic is being acknowledged; no need to probe
+                self.passive_checks += 1
+                self.enter(self.CONNECTED, self.last_healthy + self.probe_interval)
+                return True
+        
+        self.active_checks += 1
+        self.track_links()
+        if self.test_lan_connectivity():
+            self.last_healthy = time.monotonic()
+            if self.state == self.CONNECTED:
+                if self.is_connected:
+                    self.probe_interval = min(self.probe_interval * 2, self.check_interval_max)
+                self.is_connected = True
+                self.enter(self.CONNECTED, now + self.probe_interval)
+            else:
+                self.recovered('probe answered')
+            return self.is_connected
+        
+        if self.state == self.CONNECTED:
+            if self.is_connected:
+                logger.warning("LAN connectivity lost!")
+            self.is_connected = False
+            self.probe_interval = self.check_interval
+            self.outage_started = now
+            self.metrics.outage_started()
+            self.attempt = 0
+            self.plan = self.remediation_plan()
+            self.enter(self.REMEDIATING, now)
+        elif now < self.next_due:
+            # Woken early but still unreachable: let the running action settle
+            return self.is_connected
+        
+        if self.action_running():
+            # Settled but the command has not exited yet; look again shortly
+            self.enter(self.state, min(self.action[2], now + 1.0))
+            return self.is_connected
+        
+        if self.state == self.BACKOFF:
+            self.plan = self.remediation_plan()
+            self.enter(self.REMEDIATING, now)
+        
+        while self.plan:
+            settle = self.run_action(self.plan.popleft())
+            if settle:
+                self.enter(self.REMEDIATING, time.monotonic() + settle)
+                return self.is_connected
+        
+        if now - self.outage_started >= self.reconnect_timeout and not self.gave_up:
+            logger.error(f"Failed to restore LAN connectivity after {self.reconnect_timeout} seconds, "
+                         f"retrying every {self.backoff_max:.0f} seconds at most")
+            self.gave_up = True
+        delay = self.backoff_delay()
+        self.attempt += 1
+        logger.info(f"Network still unreachable, next reconnection round in {delay:.1f} seconds")
+        self.enter(self.BACKOFF, time.monotonic() + delay)
+        return self.is_connected
+
+
+class PinSlot:
+    """Last known state of one pin.
+
+    Each slot has a single writer at a time - a pin's edges are delivered
+    serially, by its backend thread or under its debouncer's lock - so
+    writers never wait and edges on different pins share nothing. Other
+    threads read it through a sequence lock: the writer makes seq odd while
+    it updates and even again when done, and a reader retries if it saw an
+    odd seq or the seq changed underneath it.
+    """
+    __slots__ = ('pin', 'seq', 'level', 'since_ns', 'edges')
+    
+    def __init__(self, pin, level, since_ns):
+        self.pin = pin
+        self.seq = 0
+        self.level = level
+        self.since_ns = since_ns
+        self.edges = 0
+    
+    def record(self, level, timestamp_ns):
+        """Store a new level (writer thread only); returns how long the old one was held in ns"""
+        held_ns = max(timestamp_ns - self.since_ns, 0)
+        self.seq += 1
+        self.level = level
+        self.since_ns = timestamp_ns
+        self.edges += 1
+        self.seq += 1
+        return held_ns
+    
+    def snapshot(self):
+        """Consistent (level, since_ns, edges) from any thread"""
+        while True:
+            seq = self.seq
+            if not seq & 1:
+                snapshot = (self.level, self.since_ns, self.edges)
+                if self.seq == seq:
+                    return snapshot
+            time.sleep(0)
+
+class ChatterState:
+    """Chatter tracking for one pin (sender thread only)"""
+    def __init__(self, threshold):
+        self.recent = deque(maxlen=threshold)  # monotonic ns of the latest edges
+        self.active = False
+        self.level = True
+        self.period_start_ns = 0
+        self.mark_ns = 0  # time up to which high_ns/low_ns have been counted
+        self.last_edge_ns = 0
+        self.reset()
+    
+    def reset(self):
+        self.toggles = 0
+        self.high_ns = 0
+        self.low_ns = 0
+        self.first_ts_ms = None
+        self.last_ts_ms = None
+    
+    def count_time(self, now_ns):
+        held_ns = max(now_ns - self.mark_ns, 0)
+        if self.level:
+            self.high_ns += held_ns
+        else:
+            self.low_ns += held_ns
+        self.mark_ns = max(now_ns, self.mark_ns)
+
+class ChatterSuppressor:
+    """Per-pin rate limiter for failing contacts.
+
+    A pin that toggles threshold times within window seconds goes into
+    chatter mode: its edges are no longer sent (or logged) one by one, and
+    every summary_interval a summary is produced instead - toggle count,
+    time spent HIGH and LOW, and the first and last edge of the period.
+    After quiet_time seconds without a toggle the pin gets a final summary
+    carrying the level it settled on, and reports edges normally again.
+    Runs on the sender thread only.
+    """
+    def __init__(self, pins, threshold=20, window=1.0, summary_interval=10.0, quiet_time=5.0):
+        self.threshold = max(2, threshold)
+        self.window_ns = int(window * 1e9)
+        self.interval_ns = int(summary_interval * 1e9)
+        self.quiet_ns = int(quiet_time * 1e9)
+        self.pins = {pin: ChatterState(self.threshold) for pin in pins}
+        self.suppressed = 0
+        self.summaries = 0
+        self.episodes = 0
+    
+    def admit(self, event):
+        """Returns True if the edge should be sent on its own"""
+        state = self.pins[event['pin']]
+        timestamp_ns = event['timestamp_ns']
+        state.recent.append(timestamp_ns)
+        
+        if not state.active:
+            if len(state.recent) == self.threshold and timestamp_ns - state.recent[0] <= self.window_ns:
+                # This edge still goes out; everything after it is summarized
+                state.active = True
+                state.level = event['state']
+                state.period_start_ns = state.mark_ns = state.last_edge_ns = timestamp_ns
+                state.reset()
+                self.episodes += 1
+                logger.warning(f"Pin {event['pin']} is chattering ({self.threshold} toggles within "
+                               f"{self.window_ns / 1e9:g}s) - sending summaries instead of edges")
+            return True
+        
+        state.count_time(timestamp_ns)
+        state.level = event['state']
+        state.toggles += 1
+        if state.first_ts_ms is None:
+            state.first_ts_ms = event['ts_ms']
+        state.last_ts_ms = event['ts_ms']
+        state.last_edge_ns = timestamp_ns
+        self.suppressed += 1
+        return False
+    
+    def due(self, now_ns):
+        """Summaries that are due, as (pin, fields) pairs; ends episodes on quiet pins"""
+        summaries = []
+        for pin, state in self.pins.items():
+            if not state.active:
+                continue
+            quiet = now_ns - state.last_edge_ns >= self.quiet_ns
+            if not quiet and now_ns - state.period_start_ns < self.interval_ns:
+                continue
+            
+            state.count_time(now_ns)
+            summaries.append((pin, {
+                'period_ns': now_ns - state.period_start_ns,
+                'toggles': state.toggles,
+                'high_sec': round(state.high_ns / 1e9, 3),
+                'low_sec': round(state.low_ns / 1e9, 3),
+                'first_ts_ms': state.first_ts_ms,
+                'last_ts_ms': state.last_ts_ms,
+                'level': 'HIGH' if state.level else 'LOW',
+                'final': quiet
+            }))
+            state.reset()
+            state.period_start_ns = now_ns
+            if quiet:
+                state.active = False
+                state.recent.clear()
+                logger.info(f"Pin {pin} stopped chattering, settled {'HIGH' if state.level else 'LOW'}")
+        self.summaries += len(summaries)
+        return summaries
+    
+    def get_stats(self):
+        return {
+            'chatter_active': sum(1 for state in self.pins.values() if state.active),
+            'chatter_episodes': self.episodes,
+            'chatter_suppressed': self.suppressed,
+            'chatter_summaries': self.summaries
+        }
+
+class MonotonicWallClock:
+    """Maps CLOCK_MONOTONIC nanoseconds onto the wall clock.
+
+    Edges are timed on the monotonic clock, so durations survive NTP steps.
+    The monotonic-to-wall offset is resampled at most once per
+    resync_interval, which keeps the per-edge cost to one addition while
+    still following a stepped or slewed wall clock within that interval.
+    """
+    def __init__(self, resync_interval=1.0):
+        self.resync_ns = int(resync_interval * 1e9)
+        self.anchor = self.sample()
+    
+    def sample(self):
+        before = time.monotonic_ns()
+        wall = time.time_ns()
+        after = time.monotonic_ns()
+        return after, wall - (before + after) // 2
+    
+    def wall_ns(self, monotonic_ns):
+        sampled_at, offset = self.anchor
+        if monotonic_ns - sampled_at > self.resync_ns:
+            sampled_at, offset = self.anchor = self.sample()
+        return monotonic_ns + offset
+
+class EdgeSource:
+    """Base class for pin edge capture backends.
+
+    A source reports every edge as on_edge(pin, level, timestamp_ns), where
+    level is True for HIGH and timestamp_ns is on the CLOCK_MONOTONIC
+    timeline, as close to the physical edge as the backend allows.
+    Sources with HARDWARE_DEBOUNCE filter each pin with the debounce_ms
+    {pin: ms} they are constructed with; the rest report raw edges.
+    """
+    HARDWARE_DEBOUNCE = False
+    
+    def __init__(self, pins):
+        self.pins = pins
+        self.on_edge = None
+    
+    def start(self, on_edge):
+        self.on_edge = on_edge
+    
+    def read_levels(self):
+        """Current level of every pin as {pin: level}"""
+        raise NotImplementedError
+    
+    def close(self):
+        pass
     
-    def test_server_connectivity(self):
-        """Test connectivity to the specific server"""
-        try:
-            sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
-            sock.settimeout(5)
-            result = sock.connect_ex((self.server_ip, self.server_port))
-            sock.close()
-            return result == 0
-        except Exception as e:
-            logger.debug(f"Error testing server connectivity: {e}")
-            return False
+    def get_stats(self):
+        return {}
+
+class GpiozeroEdgeSource(EdgeSource):
+    """gpiozero Button objects; edges are timestamped when the Python callback runs"""
+    HARDWARE_DEBOUNCE = True
     
-    def test_gateway_connectivity(self):
-        """Test connectivity to the default gateway"""
-        if not self.gateway_ip:
-            self.gateway_ip = self.get_default_gateway()
-            if not self.gateway_ip:
-                logger.debug("No default gateway found")
-                return False
+    def __init__(self, pins, debounce_ms):
+        super().__init__(pins)
+        if Button is None:
+            raise RuntimeError("gpiozero is not installed")
+        self.buttons = {}
         
-        try:
-            # Ping the gateway
-            result = subprocess.run(['ping', '-c', '1', '-W', '3', self.gateway_ip], 
-                                  capture_output=True, timeout=10)
-            return result.returncode == 0
-        except Exception as e:
-            logger.debug(f"Error pinging gateway {self.gateway_ip}: {e}")
-            return False
+        # Setup pins with pull-up resistors using gpiozero, each with its own bounce time
+        for pin in pins:
+            self.buttons[pin] = Button(pin, pull_up=True, bounce_time=debounce_ms[pin]/1000.0 or None)
     
-    def test_lan_connectivity(self):
-        """Test LAN connectivity using available methods"""
-        connectivity_tests = []
+    def start(self, on_edge):
+        super().start(on_edge)
+        for pin, button in self.buttons.items():
+            button.when_pressed = lambda p=pin: self.pin_pressed(p)
+            button.when_released = lambda p=pin: self.pin_released(p)
+    
+    def pin_pressed(self, pin):
+        """Callback function when a pin is pressed (goes LOW)"""
+        self.on_edge(pin, False, time.monotonic_ns())  # False = LOW
+    
+    def pin_released(self, pin):
+        """Callback function when a pin is released (goes HIGH)"""
+        self.on_edge(pin, True, time.monotonic_ns())  # True = HIGH
+    
+    def read_levels(self):
+        # gpiozero inverts logic for buttons
+        return {pin: not button.is_pressed for pin, button in self.buttons.items()}
+    
+    def close(self):
+        for button in self.buttons.values():
+            button.close()
+
+class SimulatedLineRequest:
+    """Stand-in for a gpiod line request, for running the gpiod backend off the Pi.
+
+    Edges injected with inject() are queued and signalled through a pipe, so
+    the epoll drain loop works exactly as it does on the real character device.
+    """
+    RISING_EDGE = 'rising'
+    FALLING_EDGE = 'falling'
+    
+    class EdgeEvent:
+        __slots__ = ('line_offset', 'event_type', 'timestamp_ns', 'line_seqno')
         
-        # Test server connectivity if enabled
-        if self.server_check:
-            server_ok = self.test_server_connectivity()
-            connectivity_tests.append(('server', server_ok))
-            if server_ok:
-                return True  # If server is reachable, we're good
+        def __init__(self, line_offset, event_type, timestamp_ns, line_seqno):
+            self.line_offset = line_offset
+            self.event_type = event_type
+            self.timestamp_ns = timestamp_ns
+            self.line_seqno = line_seqno
+    
+    def __init__(self, pins):
+        self.levels = {pin: True for pin in pins}  # pull-ups: idle HIGH
+        self.seqnos = {pin: 0 for pin in pins}
+        self.events = deque()
+        self.lock = threading.Lock()
+        self.read_fd, self.write_fd = os.pipe()
+        os.set_blocking(self.read_fd, False)
+        self.fd = self.read_fd
+    
+    def inject(self, pin, level, timestamp_ns=None):
+        """Simulate the line changing to level; repeated levels are ignored like real edges"""
+        with self.lock:
+            if self.levels[pin] == level:
+                return
+            self.levels[pin] = level
+            self.seqnos[pin] += 1
+            event_type = self.RISING_EDGE if level else self.FALLING_EDGE
+            self.events.append(self.EdgeEvent(pin, event_type, timestamp_ns or time.monotonic_ns(),
+                                              self.seqnos[pin]))
+        os.write(self.write_fd, b'\x01')
+    
+    def read_edge_events(self, max_events=None):
+        with self.lock:
+            count = len(self.events) if max_events is None else min(max_events, len(self.events))
+            events = [self.events.popleft() for _ in range(count)]
+        try:
+            os.read(self.read_fd, max(count, 1))
+        except BlockingIOError:
+            pass
+        return events
+    
+    def wait_edge_events(self, timeout=None):
+        """True if events are queued (never blocks, whatever the timeout)"""
+        with self.lock:
+            return bool(self.events)
+    
+    def get_value(self, pin):
+        with self.lock:
+            return self.levels[pin]
+    
+    def release(self):
+        os.close(self.read_fd)
+        os.close(self.write_fd)
+
+def debounce_groups(pins, debounce_ms):
+    """Group pins by debounce period as {period_ms: (pin, ...)} for a gpiod line config"""
+    periods = {}
+    for pin in pins:
+        periods.setdefault(debounce_ms[pin], []).append(pin)
+    return {period_ms: tuple(lines) for period_ms, lines in periods.items()}
+
+class GpiodEdgeSource(EdgeSource):
+    """Edge capture from the GPIO character device via libgpiod (v2 API).
+
+    The kernel timestamps every edge (CLOCK_MONOTONIC, nanoseconds) when the
+    interrupt fires, so durations are unaffected by callback latency, GIL
+    contention or a busy sender. A dedicated thread waits on the request fd
+    with epoll and drains all pending events in bulk reads. With
+    simulated=True a SimulatedLineRequest replaces the hardware.
+    """
+    MAX_EVENTS_PER_READ = 64
+    
+    HARDWARE_DEBOUNCE = True
+    
+    def __init__(self, pins, debounce_ms, chip='/dev/gpiochip0', simulated=False):
+        super().__init__(pins)
+        self.running = False
+        self.thread = None
+        self.wake_fd = os.eventfd(0, os.EFD_NONBLOCK)
+        self.line_seqnos = {}
+        self.edges = 0
+        self.missed = 0
+        self.reads = 0
         
-        # Test gateway connectivity if enabled
-        if self.gateway_check:
-            gateway_ok = self.test_gateway_connectivity()
-            connectivity_tests.append(('gateway', gateway_ok))
-            if gateway_ok:
-                return True  # If gateway is reachable, network is up
+        if simulated:
+            self.request = SimulatedLineRequest(pins)
+            self.rising_edge = SimulatedLineRequest.RISING_EDGE
+            self.HARDWARE_DEBOUNCE = False  # the stand-in has no line debounce
+            return
         
-        # Log test results
-        test_results = ', '.join([f"{name}: {result}" for name, result in connectivity_tests])
-        logger.debug(f"Connectivity tests - {test_results}")
+        import gpiod
+        from gpiod.line import Bias, Clock, Direction, Edge, Value
+        from datetime import timedelta
         
-        # If no tests were enabled or all failed
-        return False
+        # The kernel debounces each line; pins sharing a period share a settings object
+        config = {}
+        for period_ms, lines in debounce_groups(pins, debounce_ms).items():
+            config[lines] = gpiod.LineSettings(direction=Direction.INPUT, edge_detection=Edge.BOTH,
+                                               bias=Bias.PULL_UP, event_clock=Clock.MONOTONIC,
+                                               debounce_period=timedelta(milliseconds=period_ms))
+        self.request = gpiod.request_lines(chip, consumer='gpio_monitor', config=config)
+        self.rising_edge = gpiod.EdgeEvent.Type.RISING_EDGE
+        self.active_value = Value.ACTIVE
+    
+    def start(self, on_edge):
+        super().start(on_edge)
+        self.running = True
+        self.thread = threading.Thread(target=self.capture_loop, name='gpiod-capture', daemon=True)
+        self.thread.start()
     
-    def restart_network_interface(self, interface):
-        """Restart a network interface"""
+    def read_levels(self):
+        if isinstance(self.request, SimulatedLineRequest):
+            return {pin: self.request.get_value(pin) for pin in self.pins}
+        return {pin: self.request.get_value(pin) == self.active_value for pin in self.pins}
+    
+    def capture_loop(self):
+        epoll = select.epoll()
+        epoll.register(self.request.fd, select.EPOLLIN)
+        epoll.register(self.wake_fd, select.EPOLLIN)
+        logger.info(f"gpiod capture thread started for pins {self.pins}")
+        
         try:
-            logger.info(f"Restarting network interface {interface}")
-            
-            # Bring interface down
-            subprocess.run(['sudo', 'ip', 'link', 'set', interface, 'down'], 
-                         timeout=30, check=True)
-            time.sleep(2)
-            
-            # Bring interface up
-            subprocess.run(['sudo', 'ip', 'link', 'set', interface, 'up'], 
-                         timeout=30, check=True)
-            time.sleep(5)
-            
-            return True
-        except subprocess.CalledProcessError as e:
-            logger.error(f"Error restarting interface {interface}: {e}")
-            return False
+            while self.running:
+                for fd, mask in epoll.poll():
+                    if fd == self.wake_fd:
+                        continue
+                    self.drain()
         except Exception as e:
-            logger.error(f"Unexpected error restarting interface {interface}: {e}")
-            return False
+            logger.error(f"gpiod capture loop failed: {e}")
+        finally:
+            epoll.close()
     
-    def restart_wifi(self):
-        """Restart WiFi connection"""
-        try:
-            logger.info("Attempting to restart WiFi connection")
-            
-            # First try to restart the interface
-            if self.restart_network_interface(self.wifi_interface):
-                time.sleep(10)  # Wait for connection to establish
+    def drain(self):
+        """Read every pending edge event, in kernel order, in as few reads as possible"""
+        while True:
+            events = self.request.read_edge_events(self.MAX_EVENTS_PER_READ)
+            self.reads += 1
+            for event in events:
+                pin = event.line_offset
                 
-                # If interface restart didn't work, try wpa_supplicant restart
-                if not self.check_interface_status(self.wifi_interface):
-                    logger.info("Restarting wpa_supplicant service")
-                    subprocess.run(['sudo', 'systemctl', 'restart', 'wpa_supplicant'], 
-                                 timeout=30, check=True)
-                    time.sleep(15)
+                # Per-line sequence numbers expose events lost to a kernel buffer overflow
+                last = self.line_seqnos.get(pin)
+                if last is not None and event.line_seqno > last + 1:
+                    self.missed += event.line_seqno - last - 1
+                    logger.warning(f"Pin {pin}: {event.line_seqno - last - 1} edge events lost in kernel buffer")
+                self.line_seqnos[pin] = event.line_seqno
                 
-                # Try DHCP renewal
-                logger.info("Renewing DHCP lease")
-                subprocess.run(['sudo', 'dhclient', '-r', self.wifi_interface], 
-                             timeout=30)
-                time.sleep(2)
-                subprocess.run(['sudo', 'dhclient', self.wifi_interface], 
-                             timeout=30)
-                time.sleep(10)
-                
-                # Update gateway after network restart
-                self.gateway_ip = None
-                
-                return self.check_interface_status(self.wifi_interface)
-            
-            return False
+                self.edges += 1
+                self.on_edge(pin, event.event_type == self.rising_edge, event.timestamp_ns)
             
+            # A full read may have left more behind, but reading an empty request blocks
+            if len(events) < self.MAX_EVENTS_PER_READ or not self.request.wait_edge_events(0):
+                return
+    
+    def close(self):
+        if self.running:
+            self.running = False
+            os.eventfd_write(self.wake_fd, 1)
+            self.thread.join(2)
+        self.request.release()
+        os.close(self.wake_fd)
+    
+    def get_stats(self):
+        return {
+            'capture_edges': self.edges,
+            'capture_missed': self.missed,
+            'capture_reads': self.reads
+        }
+
+class SimulatedLineBank:
+    """Stand-in for a gpiod line request read as one bitmask, for running off the Pi"""
+    def __init__(self, pins):
+        self.offsets = list(pins)
+        self.index = {pin: i for i, pin in enumerate(self.offsets)}
+        self.lock = threading.Lock()
+        self.bits = (1 << len(self.offsets)) - 1  # pull-ups: idle HIGH
+    
+    def inject(self, pin, level):
+        """Simulate the line changing to level"""
+        bit = 1 << self.index[pin]
+        with self.lock:
+            self.bits = self.bits | bit if level else self.bits & ~bit
+    
+    def read_bits(self):
+        return self.bits
+    
+    def get_value(self, pin):
+        return bool(self.bits >> self.index[pin] & 1)
+    
+    def release(self):
+        pass
+
+class GpiodLineBank:
+    """All input lines in one gpiod request, read as a bitmask with a single ioctl.
+
+    Bit i of the result is the level of offsets[i]. Line values reflect the
+    kernel's per-line debounce.
+    """
+    GPIO_V2_LINE_GET_VALUES_IOCTL = 0xC010B40E  # _IOWR(0xB4, 0x0E, struct gpio_v2_line_values)
+    LINE_VALUES = struct.Struct('=QQ')  # bits, mask
+    
+    def __init__(self, pins, debounce_ms, chip):
+        import gpiod
+        from gpiod.line import Bias, Direction
+        from datetime import timedelta
+        
+        config = {}
+        for period_ms, lines in debounce_groups(pins, debounce_ms).items():
+            config[lines] = gpiod.LineSettings(direction=Direction.INPUT, bias=Bias.PULL_UP,
+                                               debounce_period=timedelta(milliseconds=period_ms))
+        self.request = gpiod.request_lines(chip, consumer='gpio_monitor', config=config)
+        self.offsets = list(self.request.offsets)
+        self.index = {pin: i for i, pin in enumerate(self.offsets)}
+        self.buffer = bytearray(self.LINE_VALUES.size)
+        self.LINE_VALUES.pack_into(self.buffer, 0, 0, (1 << len(self.offsets)) - 1)
+    
+    def read_bits(self):
+        fcntl.ioctl(self.request.fd, self.GPIO_V2_LINE_GET_VALUES_IOCTL, self.buffer, True)
+        return self.LINE_VALUES.unpack_from(self.buffer)[0]
+    
+    def get_value(self, pin):
+        return bool(self.read_bits() >> self.index[pin] & 1)
+    
+    def release(self):
+        self.request.release()
+
+class BankSamplingEdgeSource(EdgeSource):
+    """Samples every pin at a fixed interval with one bulk read.
+
+    Each sample is a single bitmask read; XOR with the previous sample gives
+    the changed pins, and only their bits are visited. An idle sample costs
+    the same for 4 pins or 26, so one station can watch a whole header
+    without a callback machinery per pin. Edges are timestamped with the
+    sample, so their resolution is the sampling interval. With
+    simulated=True a SimulatedLineBank replaces the hardware.
+    """
+    HARDWARE_DEBOUNCE = True
+    
+    def __init__(self, pins, debounce_ms, interval_ms=1.0, chip='/dev/gpiochip0', simulated=False):
+        super().__init__(pins)
+        if simulated:
+            self.bank = SimulatedLineBank(pins)
+            self.HARDWARE_DEBOUNCE = False
+        else:
+            self.bank = GpiodLineBank(pins, debounce_ms, chip)
+        self.interval_ns = int(interval_ms * 1e6)
+        self.bit_pins = self.bank.offsets
+        self.last_bits = self.bank.read_bits()
+        self.running = False
+        self.thread = None
+        self.samples = 0
+        self.edges = 0
+        self.overruns = 0
+    
+    def start(self, on_edge):
+        super().start(on_edge)
+        self.running = True
+        self.thread = threading.Thread(target=self.sample_loop, name='bank-sampler', daemon=True)
+        self.thread.start()
+    
+    def read_levels(self):
+        bits = self.last_bits
+        return {pin: bool(bits >> i & 1) for i, pin in enumerate(self.bit_pins)}
+    
+    def sample(self):
+        """Read all pins once and report the ones that changed; returns the edge count"""
+        timestamp_ns = time.monotonic_ns()
+        bits = self.bank.read_bits()
+        changed = bits ^ self.last_bits
+        self.samples += 1
+        if not changed:
+            return 0
+        
+        self.last_bits = bits
+        edges = 0
+        while changed:
+            lowest = changed & -changed
+            self.on_edge(self.bit_pins[lowest.bit_length() - 1], bool(bits & lowest), timestamp_ns)
+            changed ^= lowest
+            edges += 1
+        self.edges += edges
+        return edges
+    
+    def sample_loop(self):
+        logger.info(f"Bank sampler started for pins {self.bit_pins} every {self.interval_ns / 1e6:g} ms")
+        next_ns = time.monotonic_ns()
+        try:
+            while self.running:
+                self.sample()
+                next_ns += self.interval_ns
+                delay_ns = next_ns - time.monotonic_ns()
+                if delay_ns > 0:
+                    time.sleep(delay_ns / 1e9)
+                else:
+                    # Fell behind: skip the missed ticks rather than bursting to catch up
+                    self.overruns += 1
+                    next_ns = time.monotonic_ns()
         except Exception as e:
-            logger.error(f"Error restarting WiFi: {e}")
-            return False
+            logger.error(f"Bank sampler failed: {e}")
+    
+    def close(self):
+        if self.running:
+            self.running = False
+            self.thread.join(2)
+        self.bank.release()
+    
+    def get_stats(self):
+        return {
+            'bank_samples': self.samples,
+            'bank_edges': self.edges,
+            'bank_overruns': self.overruns
+        }
+
+class PlaybackEdgeSource(EdgeSource):
+    """Emits scripted edges from a thread, paced against the monotonic clock.
+
+    Subclasses provide edges() yielding (offset_ns, pin, level) in time
+    order. With speed 1.0 edges are emitted in real time, 10.0 replays ten
+    times faster and 0 emits them as fast as possible. Timestamps always
+    follow the script (scaled by speed), so durations stay meaningful even
+    when the pipeline is being driven flat out. Without autostart, playback
+    waits for release() so a caller can let the rest of the pipeline settle.
+    """
+    def __init__(self, pins, speed=1.0, autostart=True):
+        super().__init__(pins)
+        self.speed = speed
+        self.autostart = autostart
+        self.levels = {pin: True for pin in pins}  # pull-ups: idle HIGH
+        self.running = False
+        self.thread = None
+        self.stop_event = threading.Event()
+        self.emitted = 0
+        self.finished = threading.Event()
+    
+    def edges(self):
+        raise NotImplementedError
+    
+    def start(self, on_edge):
+        super().start(on_edge)
+        self.running = True
+        if self.autostart:
+            self.release()
+    
+    def release(self):
+        """Begin playback; the script's clock starts now"""
+        if self.thread is None:
+            self.thread = threading.Thread(target=self.playback_loop, name='playback', daemon=True)
+            self.thread.start()
     
-    def restart_ethernet(self):
-        """Restart Ethernet connection"""
+    def read_levels(self):
+        return dict(self.levels)
+    
+    def playback_loop(self):
+        start_ns = time.monotonic_ns()
         try:
-            logger.info("Attempting to restart Ethernet connection")
-            
-            if self.restart_network_interface(self.ethernet_interface):
-                time.sleep(5)
-                
-                # Try DHCP renewal
-                logger.info("Renewing DHCP lease for Ethernet")
-                subprocess.run(['sudo', 'dhclient', '-r', self.ethernet_interface], 
-                             timeout=30)
-                time.sleep(2)
-                subprocess.run(['sudo', 'dhclient', self.ethernet_interface], 
-                             timeout=30)
-                time.sleep(10)
+            for offset_ns, pin, level in self.edges():
+                if not self.running:
+                    break
+                if self.levels.get(pin) == level:
+                    continue
                 
-                # Update gateway after network restart
-                self.gateway_ip = None
+                if self.speed > 0:
+                    timestamp_ns = start_ns + int(offset_ns / self.speed)
+                    delay = (timestamp_ns - time.monotonic_ns()) / 1e9
+                    if delay > 0 and self.stop_event.wait(delay):
+                        break
+                else:
+                    timestamp_ns = start_ns + offset_ns
                 
-                return self.check_interface_status(self.ethernet_interface)
-            
-            return False
-            
+                self.levels[pin] = level
+                self.emitted += 1
+                self.on_edge(pin, level, timestamp_ns)
         except Exception as e:
-            logger.error(f"Error restarting Ethernet: {e}")
-            return False
+            logger.error(f"Edge playback failed: {e}")
+        finally:
+            self.finished.set()
+        logger.info(f"Edge playback finished after {self.emitted} edges")
     
-    def attempt_reconnection(self):
-        """Attempt to reconnect to the internet"""
-        logger.info("Starting network reconnection attempts")
-        start_time = time.time()
-        
-        while time.time() - start_time < self.reconnect_timeout:
-            # Check current interface status
-            wifi_up = self.check_interface_status(self.wifi_interface)
-            ethernet_up = self.check_interface_status(self.ethernet_interface)
-            
-            logger.info(f"Interface status - WiFi: {wifi_up}, Ethernet: {ethernet_up}")
-            
-            # Try to restart interfaces that are down
-            if not wifi_up:
-                if self.restart_wifi():
-                    logger.info("WiFi restart successful")
-                    if self.test_lan_connectivity():
-                        logger.info("LAN connectivity restored via WiFi")
-                        return True
-            
-            if not ethernet_up:
-                if self.restart_ethernet():
-                    logger.info("Ethernet restart successful")
-                    if self.test_lan_connectivity():
-                        logger.info("LAN connectivity restored via Ethernet")
-                        return True
-            
-            # If interfaces are up but no LAN connectivity, try connectivity test
-            if (wifi_up or ethernet_up) and self.test_lan_connectivity():
-                logger.info("LAN connectivity confirmed")
-                return True
+    def close(self):
+        self.running = False
+        self.stop_event.set()
+        if self.thread:
+            self.thread.join(2)
+    
+    def get_stats(self):
+        return {'playback_edges': self.emitted}
+
+class SyntheticEdgeSource(PlaybackEdgeSource):
+    """Generates edge traffic from per-pin statistical profiles.
+
+    poisson  - presses and releases with exponentially distributed gaps
+    chatter  - like poisson, but every transition bounces for a while at
+               chatter_rate toggles per second (a failing contact)
+    hold     - short gaps between long presses (e-stops, pull-cords)
+    """
+    PROFILES = ('poisson', 'chatter', 'hold')
+    
+    def __init__(self, pins, profiles, rate=0.2, hold_time=300.0, chatter_rate=200.0,
+                 chatter_duration=0.5, duration=0.0, speed=1.0, seed=None, autostart=True):
+        super().__init__(pins, speed, autostart)
+        for pin, profile in profiles.items():
+            if profile not in self.PROFILES:
+                raise ValueError(f"Unknown synthetic profile {profile!r} for pin {pin}")
+        self.profiles = profiles
+        self.rate = rate
+        self.hold_time = hold_time
+        self.chatter_rate = chatter_rate
+        self.chatter_duration = chatter_duration
+        self.duration_ns = int(duration * 1e9)
+        self.seed = seed
+    
+    def pin_edges(self, pin, rng):
+        """Infinite (offset_ns, level) sequence for one pin"""
+        profile = self.profiles[pin]
+        t = 0.0
+        level = True
+        while True:
+            if profile == 'hold':
+                t += rng.expovariate(self.rate) if level else rng.expovariate(1.0 / self.hold_time)
+            else:
+                t += rng.expovariate(self.rate)
             
-            # Wait before next attempt
-            logger.info("Waiting 30 seconds before next reconnection attempt")
-            time.sleep(30)
-        
-        logger.error(f"Failed to restore LAN connectivity after {self.reconnect_timeout} seconds")
-        return False
+            level = not level
+            if profile == 'chatter':
+                # Bounce around the new level before settling on it
+                bounce_end = t + rng.uniform(0.5, 1.0) * self.chatter_duration
+                bounce_level = level
+                while t < bounce_end:
+                    yield int(t * 1e9), bounce_level
+                    bounce_level = not bounce_level
+                    t += rng.expovariate(self.chatter_rate)
+            yield int(t * 1e9), level
     
-    def check_connectivity(self):
-        """Check network connectivity and attempt reconnection if needed"""
-        current_time = time.time()
-        
-        # Only check if enough time has passed since last check
-        if current_time - self.last_check_time < self.check_interval:
-            return self.is_connected
-        
-        self.last_check_time = current_time
+    def edges(self):
+        rng = random.Random(self.seed)
+        streams = {pin: self.pin_edges(pin, random.Random(rng.random())) for pin in self.profiles}
+        heap = [(next(stream), pin) for pin, stream in streams.items()]
+        heapq.heapify(heap)
         
-        # Test internet connectivity
-        was_connected = self.is_connected
-        self.is_connected = self.test_lan_connectivity()
-        
-        if not self.is_connected:
-            if was_connected:
-                logger.warning("LAN connectivity lost!")
+        while heap:
+            (offset_ns, level), pin = heapq.heappop(heap)
+            if self.duration_ns and offset_ns > self.duration_ns:
+                return
+            yield offset_ns, pin, level
+            heapq.heappush(heap, (next(streams[pin]), pin))
+
+class PinDebouncer:
+    """Software debounce state for one pin.
+
+    An edge is passed on at once if the pin has been quiet for the window
+    since the last edge passed on; edges inside the window are counted as
+    glitches and swallowed. If the contact settles on the other level inside
+    the window, that level is passed on when the window ends, stamped with
+    the last raw edge. An adaptive pin sizes its window from the bounce
+    spans it has recently seen.
+    """
+    ADAPTIVE_HISTORY = 32
+    ADAPTIVE_MIN_SAMPLES = 8
+    ADAPTIVE_MARGIN = 1.5
+    
+    def __init__(self, pin, level, window_ms, adaptive=False, min_ms=1.0, max_ms=50.0):
+        self.pin = pin
+        self.lock = threading.Lock()
+        self.adaptive = adaptive
+        self.min_ns = int(min_ms * 1e6)
+        self.max_ns = int(max_ms * 1e6)
+        # Adaptive pins start wide and narrow down as they learn the contact
+        self.window_ns = self.max_ns if adaptive else int(window_ms * 1e6)
+        self.level = level  # last level passed on
+        self.accepted_ns = 0
+        self.raw_level = level
+        self.raw_ns = 0
+        self.burst_ns = 0  # how long the contact bounced after the last accepted edge
+        self.spans = deque(maxlen=self.ADAPTIVE_HISTORY)
+        self.settle_pending = False
+        self.glitches = 0
+        self.passed = 0
+    
+    def learn(self, timestamp_ns):
+        """Fold the bounce burst that just ended into the adaptive window"""
+        held_ns = timestamp_ns - self.accepted_ns
+        # A level held for less than max_ms outlived the window: it was a bounce too
+        self.spans.append(held_ns if held_ns < self.max_ns else self.burst_ns)
+        if len(self.spans) >= self.ADAPTIVE_MIN_SAMPLES:
+            window_ns = int(max(self.spans) * self.ADAPTIVE_MARGIN)
+            self.window_ns = min(max(window_ns, self.min_ns), self.max_ns)
+    
+    def get_stats(self):
+        return {'glitches': self.glitches, 'passed': self.passed,
+                'window_ms': round(self.window_ns / 1e6, 3)}
+
+class DebounceEngine:
+    """Per-pin software debounce between a capture backend and the monitor.
+
+    Fixed windows handled by a backend with HARDWARE_DEBOUNCE are left to it
+    (window 0 here); adaptive pins always debounce here because learning
+    needs the raw bounces. Repeats of the level already passed on are
+    dropped and counted on every pin. A pin's edges are passed on under its
+    own lock, so the settle thread and the capture thread never interleave
+    on one pin and pins never wait on each other.
+    """
+    def __init__(self, levels, windows, adaptive, min_ms, max_ms):
+        self.pins = {pin: PinDebouncer(pin, level, windows.get(pin, 0), pin in adaptive, min_ms, max_ms)
+                     for pin, level in levels.items()}
+        self.on_edge = None
+        self.cond = threading.Condition()
+        self.deadlines = []  # heap of (deadline_ns, pin) for pending settle checks
+        self.running = True
+        self.thread = None
+    
+    def wrap(self, on_edge):
+        self.on_edge = on_edge
+        return self.edge
+    
+    def edge(self, pin, level, timestamp_ns):
+        debouncer = self.pins[pin]
+        with debouncer.lock:
+            if timestamp_ns - debouncer.accepted_ns < debouncer.window_ns:
+                debouncer.raw_level = level
+                debouncer.raw_ns = timestamp_ns
+                debouncer.glitches += 1
+                debouncer.burst_ns = timestamp_ns - debouncer.accepted_ns
+                if not debouncer.settle_pending:
+                    debouncer.settle_pending = True
+                    self.schedule(debouncer.accepted_ns + debouncer.window_ns, pin)
+                return
             
-            # Attempt reconnection
-            self.is_connected = self.attempt_reconnection()
+            # The window is over: settle a burst the settle thread hasn't got to yet
+            if debouncer.raw_level != debouncer.level:
+                self.accept(debouncer, debouncer.raw_level, debouncer.raw_ns)
+            debouncer.raw_level = level
+            debouncer.raw_ns = timestamp_ns
+            if level == debouncer.level:
+                debouncer.glitches += 1
+                return
+            self.accept(debouncer, level, timestamp_ns)
+    
+    def accept(self, debouncer, level, timestamp_ns):
+        """Pass an edge on (caller holds the pin's lock)"""
+        if debouncer.adaptive:
+            debouncer.learn(timestamp_ns)
+        debouncer.level = level
+        debouncer.accepted_ns = timestamp_ns
+        debouncer.burst_ns = 0
+        debouncer.passed += 1
+        self.on_edge(debouncer.pin, level, timestamp_ns)
+    
+    def schedule(self, deadline_ns, pin):
+        with self.cond:
+            if self.thread is None:
+                self.thread = threading.Thread(target=self.settle_loop, name='debounce', daemon=True)
+                self.thread.start()
+            heapq.heappush(self.deadlines, (deadline_ns, pin))
+            self.cond.notify()
+    
+    def settle_loop(self):
+        while True:
+            with self.cond:
+                while self.running and (not self.deadlines or self.deadlines[0][0] > time.monotonic_ns()):
+                    timeout = (self.deadlines[0][0] - time.monotonic_ns()) / 1e9 if self.deadlines else None
+                    self.cond.wait(timeout)
+                if not self.running:
+                    return
+                deadline_ns, pin = heapq.heappop(self.deadlines)
+            
+            debouncer = self.pins[pin]
+            with debouncer.lock:
+                debouncer.settle_pending = False
+                if debouncer.raw_level != debouncer.level and debouncer.raw_ns - debouncer.accepted_ns < debouncer.window_ns:
+                    self.accept(debouncer, debouncer.raw_level, debouncer.raw_ns)
+    
+    def close(self):
+        with self.cond:
+            self.running = False
+            self.cond.notify()
+        if self.thread:
+            self.thread.join(2)
+    
+    def get_stats(self):
+        pins = {pin: debouncer.get_stats() for pin, debouncer in self.pins.items()}
+        return {
+            'debounce_glitches': sum(pin['glitches'] for pin in pins.values()),
+            'debounce': pins
+        }
+
+TRACE_MAGIC = '# andon-trace 1'
+
+class TraceReplayEdgeSource(PlaybackEdgeSource):
+    """Replays an edge trace written by TraceRecorder"""
+    def __init__(self, pins, path, speed=1.0, loop=False, autostart=True):
+        super().__init__(pins, speed, autostart)
+        self.path = path
+        self.loop = loop
+        self.skipped = 0
         
-        return self.is_connected
+        with open(path) as f:
+            if f.readline().strip() != TRACE_MAGIC:
+                raise ValueError(f"{path} is not an edge trace")
+            header = f.readline().split()
+        if header[:2] == ['#', 'levels']:
+            for item in header[2:]:
+                pin, level = item.split('=')
+                if int(pin) in self.levels:
+                    self.levels[int(pin)] = level == '1'
+    
+    def read_trace(self):
+        with open(self.path) as f:
+            first_ns = None
+            for line in f:
+                if line.startswith('#') or not line.strip():
+                    continue
+                timestamp_ns, pin, level = (int(x) for x in line.split())
+                if pin not in self.levels:
+                    self.skipped += 1
+                    continue
+                if first_ns is None:
+                    first_ns = timestamp_ns
+                yield timestamp_ns - first_ns, pin, level == 1
+    
+    def edges(self):
+        base_ns = 0
+        while True:
+            last_ns = 0
+            for offset_ns, pin, level in self.read_trace():
+                last_ns = offset_ns
+                yield base_ns + offset_ns, pin, level
+            if not self.loop or last_ns == 0:
+                return
+            base_ns += last_ns + 1
+    
+    def get_stats(self):
+        stats = super().get_stats()
+        stats['playback_skipped'] = self.skipped
+        return stats
+
+class TraceRecorder:
+    """Records every captured edge to a trace file that TraceReplayEdgeSource can replay"""
+    def __init__(self, path, initial_levels):
+        self.file = open(path, 'w')
+        self.lock = threading.Lock()
+        levels = ' '.join(f"{pin}={int(level)}" for pin, level in sorted(initial_levels.items()))
+        self.file.write(f"{TRACE_MAGIC}\n# levels {levels}\n")
+        logger.info(f"Recording edge trace to {path}")
+    
+    def wrap(self, on_edge):
+        def record(pin, level, timestamp_ns):
+            with self.lock:
+                self.file.write(f"{timestamp_ns} {pin} {int(level)}\n")
+            on_edge(pin, level, timestamp_ns)
+        return record
+    
+    def close(self):
+        with self.lock:
+            self.file.close()
+
+class QueryRequestHandler(BaseHTTPRequestHandler):
+    """Read-only JSON over HTTP; routes come from the owning QueryServer"""
+    protocol_version = 'HTTP/1.1'  # keep-alive, so pollers skip the connect
+    server_version = 'gpio_monitor'
+    disable_nagle_algorithm = True  # headers and body are separate writes
+    
+    def do_GET(self):
+        url = urllib.parse.urlsplit(self.path)
+        route = self.server.routes.get(url.path.rstrip('/') or '/')
+        if route is None:
+            self.send_error(404, f"Unknown path; try {', '.join(sorted(self.server.routes))}")
+            return
+        try:
+            body = json.dumps(route(urllib.parse.parse_qs(url.query))).encode('utf-8')
+        except Exception as e:
+            self.send_error(500, str(e))
+            return
+        self.send_response(200)
+        self.send_header('Content-Type', 'application/json')
+        self.send_header('Content-Length', str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+    
+    def log_message(self, format, *args):
+        pass  # dashboards poll; don't fill the log
+
+class UnixQueryRequestHandler(QueryRequestHandler):
+    disable_nagle_algorithm = False  # not a TCP socket
+
+class UnixHTTPServer(socketserver.ThreadingMixIn, socketserver.UnixStreamServer):
+    daemon_threads = True
+
+class RingPublisher:
+    """Feeds the local event ring from a thread of its own.
+
+    Capture threads only put the edge on a SimpleQueue, which never blocks
+    and takes no lock they could contend on. The publisher thread is the
+    ring's single producer and does no network I/O, so local consumers see
+    an edge at once, whatever the collector path is doing.
+    """
+    def __init__(self, ring):
+        self.ring = ring
+        self.queue = SimpleQueue()
+        self.thread = threading.Thread(target=self.publish_loop, name='ring-publisher', daemon=True)
+        self.thread.start()
+    
+    @property
+    def write_seq(self):
+        return self.ring.write_seq
+    
+    def publish(self, pin, state, time_diff_ms, ts_ms, timestamp_ns):
+        """Queue one edge for the ring (any thread)"""
+        self.queue.put((pin, state, time_diff_ms, ts_ms, timestamp_ns))
+    
+    def publish_loop(self):
+        while True:
+            edge = self.queue.get()
+            if edge is None:
+                break
+            try:
+                self.ring.publish(*edge)
+            except Exception as e:
+                logger.error(f"Error publishing to local event ring: {e}")
+    
+    def close(self):
+        """Publish the edges already queued, then close the ring"""
+        self.queue.put(None)
+        self.thread.join(5)
+        self.ring.close()
+
+class QueryServer:
+    """Local endpoint answering from in-memory state.
+
+    Pin state comes from the seqlock-protected slots and recent events and
+    sends from bounded deques, so a query never takes a lock the capture
+    path uses. Served over HTTP on localhost and/or a Unix socket.
+    """
+    def __init__(self, monitor, bind='127.0.0.1', port=8765, unix_socket=''):
+        self.monitor = monitor
+        self.started = time.monotonic()
+        self.routes = {
+            '/': self.overview,
+            '/pins': lambda query: monitor.pin_snapshot(),
+            '/events': lambda query: self.tail(monitor.recent_events, query),
+            '/sends': lambda query: self.tail(monitor.channel.recent_sends, query),
+            '/stats': lambda query: monitor.get_stats(),
+            '/network': lambda query: monitor.network_manager.metrics.snapshot()
+        }
+        self.servers = []
+        if port:
+            self.servers.append(ThreadingHTTPServer((bind, port), QueryRequestHandler))
+        if unix_socket:
+            if os.path.exists(unix_socket):
+                os.unlink(unix_socket)
+            os.makedirs(os.path.dirname(unix_socket) or '.', exist_ok=True)
+            self.servers.append(UnixHTTPServer(unix_socket, UnixQueryRequestHandler))
+        self.unix_socket = unix_socket
+        for server in self.servers:
+            server.routes = self.routes
+            threading.Thread(target=server.serve_forever, name='query', daemon=True).start()
+        logger.info(f"Local query endpoint on {bind}:{port}" + (f" and {unix_socket}" if unix_socket else ""))
+    
+    def tail(self, items, query):
+        """The newest n entries (?n=, default all), oldest first"""
+        items = list(items)
+        count = int(query.get('n', [len(items)])[0])
+        return items[-count:] if count > 0 else []
+    
+    def overview(self, query):
+        monitor = self.monitor
+        return {
+            'device_name': monitor.device_name,
+            'stations': sorted(set(monitor.pin_devices.values())),
+            'connected': monitor.network_manager.is_connected,
+            'session_open': monitor.session.is_open(),
+            'uptime_sec': round(time.monotonic() - self.started, 1),
+            'pins': monitor.pin_snapshot()
+        }
+    
+    def close(self):
+        for server in self.servers:
+            server.shutdown()
+            server.server_close()
+        if self.unix_socket and os.path.exists(self.unix_socket):
+            os.unlink(self.unix_socket)
 
 class GPIOMonitor:
-    def __init__(self):
+    def __init__(self, config_file=CONFIG_FILE):
+        self.config_file = config_file
         self.config = self.load_config()
         self.device_name = self.config['device']['name']
-        self.server_ip = self.config['server']['ip']
-        self.server_port = int(self.config['server']['port'])
+        self.server_ip, self.server_port = collector_endpoints(self.config)[0]
+        self.protocol = self.config['server']['protocol'].lower()
+        self.server_timeout = float(self.config['server']['timeout'])
         self.pins = [int(pin) for pin in self.config['gpio']['pins'].split(',')]
+        self.pin_devices = self.load_stations()  # pin -> logical device name it reports as
         self.debounce_time = int(self.config['gpio']['debounce_time'])
+        self.pin_debounce = {pin: self.debounce_time for pin in self.pins}  # ms or 'adaptive'
+        for item in filter(None, self.config['gpio']['pin_debounce'].split(',')):
+            pin, setting = (part.strip() for part in item.split(':'))
+            self.pin_debounce[int(pin)] = 'adaptive' if setting.lower() == 'adaptive' else int(setting)
+        self.stats_interval = int(self.config['sender']['stats_interval'])
         
-        self.pin_states = {}
-        self.pin_timestamps = {}
+        self.pin_slots = {}  # pin -> PinSlot, fixed once capture starts
+        self.recent_events = deque(maxlen=int(self.config['query']['recent']))  # for the query endpoint
+        self.ring = None
+        if self.config['ring']['enabled'].lower() == 'true':
+            try:
+                self.ring = RingPublisher(RingWriter(self.config['ring']['path'], int(self.config['ring']['slots'])))
+                logger.info(f"Publishing edges to local event ring {self.config['ring']['path']}")
+            except (OSError, ValueError) as e:
+                logger.error(f"Could not create local event ring: {e}")
+        self.clock = MonotonicWallClock()
+        self.formatter = TimestampFormatter()
         self.running = True
-        self.last_send_failed = False  # Track if last send attempt failed
+        self.cleaned_up = False
         
         # Initialize network manager
         self.network_manager = NetworkManager(self.config)
+        self.network_manager.add_connectivity_listener(self.on_connectivity_change)
+        
+        # Persistent session to the collector (unused in legacy protocol mode): one
+        # path per collector endpoint and uplink interface, used one at a time, or
+        # with fan-out a separate set of paths for every endpoint
+        server = self.config['server']
+        endpoints = self.network_manager.endpoints
+        uplinks = self.network_manager.uplinks
+        self.fanout = None
+        fanout = server['mode'].lower() == 'fanout' and len(endpoints) > 1
+        if fanout and self.protocol == 'legacy':
+            logger.warning("Fan-out needs the framed protocol; sending to the first endpoint only")
+            fanout = False
+        
+        def open_session(host, port, interface=None):
+            return ServerSession(host, port, self.device_name, self.server_timeout,
+                                 server['encoding'].lower(),
+                                 (int(server['keepalive_idle']), int(server['keepalive_interval']),
+                                  int(server['keepalive_count'])),
+                                 float(server['user_timeout']),
+                                 interface, self.network_manager.interface_address,
+                                 self.network_manager.metrics)
+        
+        self.multipaths = []
+        def endpoint_session(targets):
+            paths = [open_session(host, port, interface) for host, port in targets for interface in uplinks or [None]]
+            if len(paths) == 1 and not uplinks:
+                return paths[0]
+            session = MultipathSession(paths)
+            self.multipaths.append(session)
+            return session
+        
+        if self.protocol == 'legacy':
+            self.session = open_session(self.server_ip, self.server_port)
+        elif fanout:
+            self.session = SessionSet([endpoint_session([endpoint]) for endpoint in endpoints])
+        else:
+            self.session = endpoint_session(endpoints)
+        if len(endpoints) > 1:
+            names = ', '.join(f"{host}:{port}" for host, port in endpoints)
+            logger.info(f"Collector endpoints ({'fan-out' if fanout else 'failover'}): {names}")
+        if uplinks:
+            logger.info(f"Uplinks in order of preference: {', '.join(uplinks)}")
+        self.sequence = SequenceCounter(self.config['sender']['sequence_file'])
+        
+        if self.protocol != 'legacy':
+            self.network_manager.session = self.session
+            self.session.on_lost = self.network_manager.note_suspect
+        if self.multipaths:
+            # A link going down moves traffic to another uplink within milliseconds
+            self.network_manager.link_listeners.append(self.close_down_paths)
         
         # Setup signal handling for graceful shutdown
         signal.signal(signal.SIGINT, self.signal_handler)
         signal.signal(signal.SIGTERM, self.signal_handler)
         
+        # Windowed, acknowledged delivery over the session (or the legacy protocol),
+        # with a store-and-forward journal for events that cannot be sent right away
+        def open_channel(session, journal):
+            return DeliveryChannel(session, journal, self.network_manager, self.sequence,
+                                   window=int(self.config['sender']['window']),
+                                   ack_timeout=float(self.config['sender']['ack_timeout']),
+                                   max_batch=int(self.config['sender']['max_batch']),
+                                   replay_batch=int(self.config['journal']['replay_batch']),
+                                   legacy_sender=self.send_data_legacy if self.protocol == 'legacy' else None)
+        
+        if fanout:
+            # Each collector gets its own journal, under a directory named after it
+            destinations = []
+            for (host, port), session in zip(endpoints, self.session.sessions):
+                journal = self.open_journal(os.path.join(self.config['journal']['path'], f"{host}_{port}"))
+                destinations.append((f"{host}:{port}", open_channel(session, journal), journal))
+            self.journal = None
+            self.channel = self.fanout = FanoutChannel(destinations, self.sequence,
+                                                       int(self.config['sender']['queue_size']),
+                                                       float(self.config['sender']['linger_ms']) / 1000.0,
+                                                       int(self.config['sender']['max_batch']))
+        else:
+            self.journal = self.open_journal(self.config['journal']['path'])
+            self.channel = open_channel(self.session, self.journal)
+        self.channel.restored_notice = self.connectivity_notice
+        # Acknowledgements prove the server is reachable, whatever the probes say
+        self.channel.ack_listeners.append(lambda events: self.network_manager.note_healthy('server acknowledged events'))
+        self.channel.recent_sends = deque(maxlen=self.recent_events.maxlen)
+        
+        # Sender thread; must be running before GPIO callbacks can fire
+        chatter = self.config['chatter']
+        self.chatter = None
+        if chatter['enabled'].lower() == 'true':
+            self.chatter = ChatterSuppressor(self.pins, int(chatter['threshold']),
+                                             float(chatter['window']),
+                                             float(chatter['summary_interval']),
+                                             float(chatter['quiet_time']))
+        
+        self.pipeline = SenderPipeline(self.process_events, int(self.config['sender']['queue_size']),
+                                       idle_handler=self.sender_idle,
+                                       linger=float(self.config['sender']['linger_ms']) / 1000.0,
+                                       max_batch=int(self.config['sender']['max_batch']))
+        self.pipeline.start()
+        if self.multipaths and not self.fanout:
+            # Retransmit on the new path now rather than at the next idle tick
+            self.multipaths[0].on_switch = self.pipeline.poke
+        
         # Initialize GPIO
         self.setup_gpio()
         
+        self.query = None
+        query = self.config['query']
+        if query['enabled'].lower() == 'true':
+            try:
+                self.query = QueryServer(self, query['bind'], int(query['port']), query['unix_socket'])
+            except OSError as e:
+                logger.error(f"Could not start local query endpoint: {e}")
+        
         # Start network monitoring thread
         self.network_thread = threading.Thread(target=self.network_monitor_loop, daemon=True)
         self.network_thread.start()
         
+    def open_journal(self, path):
+        try:
+            return EventJournal(path, int(self.config['journal']['segment_size']),
+                                int(self.config['journal']['max_size']),
+                                float(self.config['journal']['fsync_interval']))
+        except OSError as e:
+            logger.error(f"Could not open event journal {path}, offline events will be lost: {e}")
+            return None
+    
+    def close_down_paths(self):
+        """Drop sessions over interfaces that just went down (netlink thread)"""
+        for multipath in self.multipaths:
+            multipath.maintain(self.network_manager.check_interface_status, reconnect=False)
+    
     def load_config(self):
         """Load configuration from file or create default config if not exists"""
         config = configparser.ConfigParser()
@@ -349,126 +3707,229 @@ class GPIOMonitor:
                 config.set(section, key, str(value))
         
         # Try to read configuration file
-        if os.path.exists(CONFIG_FILE):
+        if os.path.exists(self.config_file):
             try:
-                config.read(CONFIG_FILE)
-                logger.info(f"Configuration loaded from {CONFIG_FILE}")
+                config.read(self.config_file)
+                logger.info(f"Configuration loaded from {self.config_file}")
             except Exception as e:
                 logger.error(f"Error loading configuration: {e}")
                 logger.info("Using default configuration")
         else:
-            logger.info(f"Config file {CONFIG_FILE} not found, using default configuration")
+            logger.info(f"Config file {self.config_file} not found, using default configuration")
             
             # Create default config file
             try:
-                with open(CONFIG_FILE, 'w') as configfile:
+                with open(self.config_file, 'w') as configfile:
                     config.write(configfile)
-                logger.info(f"Default configuration saved to {CONFIG_FILE}")
+                logger.info(f"Default configuration saved to {self.config_file}")
             except Exception as e:
                 logger.error(f"Could not save default configuration: {e}")
         
         return config
     
-    def setup_gpio(self):
-        """Initialize GPIO pins using gpiozero"""
-        self.buttons = {}
+    def load_stations(self):
+        """Map every pin to the logical device whose events it produces.
+
+        Without [station:<name>] sections all pins belong to [device] name.
+        With them, each section's pins report under the section's name (or
+        its 'name' key), and the stations' pins replace [gpio] pins. Every
+        station shares this process's capture loop, sender pipeline and
+        collector session, which is identified by [device] name.
+        """
+        sections = [section for section in self.config.sections() if section.startswith('station:')]
+        if not sections:
+            return {pin: self.device_name for pin in self.pins}
         
-        # Setup pins with pull-up resistors using gpiozero
-        for pin in self.pins:
-            # Create Button object with pull-up and debounce
-            button = Button(pin, pull_up=True, bounce_time=self.debounce_time/1000.0)
-            
-            # Set initial state and timestamp
-            self.pin_states[pin] = not button.is_pressed  # gpiozero inverts logic for buttons
-            self.pin_timestamps[pin] = time.time()
-            
-            # Add event callbacks
-            button.when_pressed = lambda p=pin: self.pin_pressed(p)
-            button.when_released = lambda p=pin: self.pin_released(p)
-            
-            # Store button object
-            self.buttons[pin] = button
-            
-        logger.info(f"GPIO pins {self.pins} initialized with pull-up resistors")
+        pin_devices = {}
+        for section in sections:
+            name = self.config[section].get('name', section.split(':', 1)[1]).strip()
+            for pin in (int(pin) for pin in self.config[section]['pins'].split(',')):
+                if pin in pin_devices:
+                    raise ValueError(f"Pin {pin} is assigned to both {pin_devices[pin]} and {name}")
+                pin_devices[pin] = name
+        self.pins = list(pin_devices)
+        return pin_devices
     
-    def pin_pressed(self, pin):
-        """Callback function when a pin is pressed (goes LOW)"""
-        current_time = time.time()
-        
-        # Calculate time difference (how long it was HIGH/released) in seconds
-        time_diff_sec = current_time - self.pin_timestamps[pin]
+    def setup_gpio(self):
+        """Initialize GPIO pins with pull-up resistors using the configured capture backend"""
+        backend = self.config['gpio']['backend'].lower()
+        simulation = self.config['simulation']
         
-        logger.info(f"Pin {pin} changed to LOW (pressed), was HIGH for {time_diff_sec:.3f} seconds")
+        # Fixed windows go to the backend where it can debounce; adaptive pins get raw edges
+        adaptive = {pin for pin, setting in self.pin_debounce.items() if setting == 'adaptive'}
+        windows = {pin: 0 if pin in adaptive else setting for pin, setting in self.pin_debounce.items()}
         
-        # Send data to server (or queue if network is down)
-        self.handle_pin_data(pin, False, time_diff_sec)  # False = LOW
+        if backend == 'gpiod':
+            self.source = GpiodEdgeSource(self.pins, windows, self.config['gpio']['chip'])
+        elif backend == 'simulated':
+            self.source = GpiodEdgeSource(self.pins, windows, simulated=True)
+        elif backend in ('bank', 'simulated-bank'):
+            self.source = BankSamplingEdgeSource(self.pins, windows,
+                                                 float(self.config['gpio']['sample_interval_ms']),
+                                                 self.config['gpio']['chip'],
+                                                 simulated=backend == 'simulated-bank')
+        elif backend == 'synthetic':
+            profiles = {pin: simulation['profile'] for pin in self.pins}
+            for item in filter(None, simulation['pin_profiles'].split(',')):
+                pin, profile = item.split(':')
+                profiles[int(pin)] = profile.strip()
+            self.source = SyntheticEdgeSource(self.pins, profiles,
+                                              rate=float(simulation['rate']),
+                                              hold_time=float(simulation['hold_time']),
+                                              chatter_rate=float(simulation['chatter_rate']),
+                                              chatter_duration=float(simulation['chatter_duration']),
+                                              duration=float(simulation['duration']),
+                                              speed=float(simulation['speed']),
+                                              seed=simulation['seed'] or None,
+                                              autostart=simulation['autostart'].lower() == 'true')
+        elif backend == 'replay':
+            self.source = TraceReplayEdgeSource(self.pins, simulation['trace'],
+                                                speed=float(simulation['speed']),
+                                                loop=simulation['loop'].lower() == 'true',
+                                                autostart=simulation['autostart'].lower() == 'true')
+        else:
+            self.source = GpiozeroEdgeSource(self.pins, windows)
         
-        # Update state and timestamp
-        self.pin_states[pin] = False  # LOW
-        self.pin_timestamps[pin] = current_time
-    
-    def pin_released(self, pin):
-        """Callback function when a pin is released (goes HIGH)"""
-        current_time = time.time()
+        # Set initial state and timestamp
+        now_ns = time.monotonic_ns()
+        levels = self.source.read_levels()
+        self.pin_slots = {pin: PinSlot(pin, level, now_ns) for pin, level in levels.items()}
         
-        # Calculate time difference (how long it was LOW/pressed) in seconds
-        time_diff_sec = current_time - self.pin_timestamps[pin]
+        if self.source.HARDWARE_DEBOUNCE:
+            windows = {}
+        self.debouncer = DebounceEngine(levels, windows, adaptive,
+                                        float(self.config['gpio']['adaptive_min_ms']),
+                                        float(self.config['gpio']['adaptive_max_ms']))
+        on_edge = self.debouncer.wrap(self.record_edge)
+        self.recorder = None
+        if self.config['gpio']['record_trace']:
+            self.recorder = TraceRecorder(self.config['gpio']['record_trace'], levels)
+            on_edge = self.recorder.wrap(on_edge)
         
-        logger.info(f"Pin {pin} changed to HIGH (released), was LOW for {time_diff_sec:.3f} seconds")
+        self.source.start(on_edge)
+        logger.info(f"GPIO pins {self.pins} initialized with pull-up resistors ({backend} backend)")
+    
+    def record_edge(self, pin, state, timestamp_ns):
+        """Hand an edge to the sender thread.
+
+        Runs in the capture backend's thread, so it must never touch the network.
+        timestamp_ns is CLOCK_MONOTONIC, which makes durations immune to wall
+        clock steps; the wall clock time is derived from it.
+        """
+        # Update state; the slot returns how long the pin held its previous state
+        held_ns = self.pin_slots[pin].record(state, timestamp_ns)
+        time_diff_sec = held_ns / 1e9
         
-        # Send data to server (or queue if network is down)
-        self.handle_pin_data(pin, True, time_diff_sec)  # True = HIGH
+        ts_ms = self.clock.wall_ns(timestamp_ns) // 1_000_000
+        if self.ring:
+            # Local consumers see the edge now, independent of the sender queue and the network path
+            self.ring.publish(pin, int(state), held_ns // 1_000_000, ts_ms, timestamp_ns)
         
-        # Update state and timestamp
-        self.pin_states[pin] = True  # HIGH
-        self.pin_timestamps[pin] = current_time
+        event = {'pin': pin, 'state': state, 'time_diff_sec': time_diff_sec, 'ts_ms': ts_ms,
+                 'timestamp_ns': timestamp_ns}
+        if not self.pipeline.submit(event):
+            logger.warning(f"Pin {pin} event dropped - sender queue full")
+            self.channel.note_failure()
     
-    def handle_pin_data(self, pin, state, time_diff_sec):
-        """Handle pin data - send immediately if network is up"""
-        data = {
-            'device_name': self.device_name,
-            'pin': pin,
-            'state': 'HIGH' if state else 'LOW',
-            'time_diff_sec': round(time_diff_sec, 3),
-            'timestamp': time.strftime('%Y-%m-%d %H:%M:%S')
-        }
-        
-        if self.network_manager.is_connected:
-            # If we previously failed to send and now we're reconnected, send warning first
-            if self.last_send_failed:
-                self.send_connectivity_warning()
-                self.last_send_failed = False
+    def process_events(self, events):
+        """Runs on the sender thread for each batch of queued edges"""
+        batch = []
+        for event in events:
+            if self.chatter and not self.chatter.admit(event):
+                continue
+            pin = event['pin']
+            state = event['state']
+            time_diff_sec = event['time_diff_sec']
             
-            success = self.send_data_to_server(data)
-            if not success:
-                logger.warning(f"Failed to send pin {pin} data to server")
-                self.last_send_failed = True
-        else:
-            logger.warning(f"Pin {pin} data lost - no network connection")
-            self.last_send_failed = True
+            if state:
+                logger.info(f"Pin {pin} changed to HIGH (released), was LOW for {time_diff_sec:.3f} seconds")
+            else:
+                logger.info(f"Pin {pin} changed to LOW (pressed), was HIGH for {time_diff_sec:.3f} seconds")
+            
+            batch.append({
+                'device_name': self.pin_devices[pin],
+                'pin': pin,
+                'state': 'HIGH' if state else 'LOW',
+                'time_diff_sec': round(time_diff_sec, 3),
+                'timestamp': self.formatter.format(event['ts_ms']),
+                'ts_ms': event['ts_ms']
+            })
+        batch.extend(self.chatter_summaries())
+        
+        # Send data to server (or journal it if network is down)
+        if batch:
+            self.recent_events.extend(dict(event) for event in batch)
+            self.handle_pin_data(batch)
     
-    def send_connectivity_warning(self):
-        """Send a connectivity warning message to the server"""
-        warning_data = {
+    def chatter_summaries(self):
+        """Summary events for chattering pins that are due (sender thread)"""
+        if not self.chatter:
+            return []
+        now_ns = time.monotonic_ns()
+        ts_ms = self.clock.wall_ns(now_ns) // 1_000_000
+        summaries = []
+        for pin, summary in self.chatter.due(now_ns):
+            logger.info(f"Pin {pin} chatter: {summary['toggles']} toggles in "
+                        f"{summary['period_ns'] / 1e9:.1f} seconds, now {summary['level']}")
+            event = {
+                'device_name': self.pin_devices[pin],
+                'pin': pin,
+                'state': 'CHATTER',
+                'time_diff_sec': round(summary.pop('period_ns') / 1e9, 3),
+                'timestamp': self.formatter.format(ts_ms),
+                'ts_ms': ts_ms
+            }
+            event.update(summary)
+            summaries.append(event)
+        return summaries
+    
+    def handle_pin_data(self, batch):
+        """Handle a batch of pin data - send immediately if network is up, journal otherwise"""
+        self.channel.deliver(batch)
+    
+    def sender_idle(self):
+        """Runs on the sender thread whenever no new edges are queued"""
+        summaries = self.chatter_summaries()
+        if summaries:
+            self.recent_events.extend(dict(event) for event in summaries)
+            self.handle_pin_data(summaries)
+        if self.journal:
+            self.journal.sync()
+        self.channel.pump()
+    
+    def connectivity_notice(self):
+        """Build the connectivity warning event sent when the server is reachable again"""
+        now_ms = time.time_ns() // 1_000_000
+        notice = {
             'device_name': self.device_name,
             'pin': -1,  # Special pin for connectivity messages
             'state': 'CONNECTIVITY_RESTORED',
             'time_diff_sec': 0.0,
-            'timestamp': time.strftime('%Y-%m-%d %H:%M:%S')
+            'timestamp': self.formatter.format(now_ms),
+            'ts_ms': now_ms
         }
-        
-        success = self.send_data_to_server(warning_data)
-        if success:
-            logger.info("Sent connectivity restoration notice to server")
+        stations = sorted(set(self.pin_devices.values()) - {self.device_name})
+        if stations:
+            notice['stations'] = stations  # logical devices that shared the outage
+        return notice
+    
+    def on_connectivity_change(self, connected):
+        """Pre-warm the collector session as soon as the network comes up"""
+        if not connected:
+            self.channel.note_failure()
+        if self.protocol == 'legacy':
+            return
+        if connected:
+            threading.Thread(target=self.session.connect, daemon=True).start()
         else:
-            logger.warning("Failed to send connectivity restoration notice")
+            self.session.close()
     
-    def send_data_to_server(self, data):
-        """Send pin change data to the server"""
+    def send_data_legacy(self, data):
+        """Send pin change data using one connection per event (pre-framing collectors)"""
         try:
             # Create socket with timeout
             s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
-            s.settimeout(5)  # 5 second timeout
+            s.settimeout(self.server_timeout)
             
             # Connect to server
             s.connect((self.server_ip, self.server_port))
@@ -508,27 +3969,67 @@ class GPIOMonitor:
     def network_monitor_loop(self):
         """Background thread to monitor network connectivity"""
         logger.info("Network monitoring thread started")
+        last_stats_time = time.time()
         
         while self.running:
             try:
+                if self.stats_interval > 0 and time.time() - last_stats_time >= self.stats_interval:
+                    last_stats_time = time.time()
+                    logger.info(f"Sender stats: {self.get_stats()}")
+                
                 # Check network connectivity
                 was_connected = self.network_manager.is_connected
                 self.network_manager.check_connectivity()
+                if self.network_manager.is_connected:
+                    # Keep a standby session open on every path that is up
+                    for multipath in self.multipaths:
+                        multipath.maintain(self.network_manager.check_interface_status)
                 
                 # Log connectivity changes
                 if was_connected and not self.network_manager.is_connected:
                     logger.warning("Network connectivity lost")
-                    self.last_send_failed = True
                 elif not was_connected and self.network_manager.is_connected:
                     logger.info("Network connectivity restored")
                     # Don't send warning here - wait for next GPIO event
                 
-                time.sleep(5)  # Check every 5 seconds
+                # Step again when the state machine is due, on a link change or an ack
+                self.network_manager.wait(min(5, self.network_manager.time_to_next_step()))
                 
             except Exception as e:
                 logger.error(f"Error in network monitoring loop: {e}")
                 time.sleep(10)
     
+    def pin_snapshot(self):
+        """Current level, time in that level and edge count of every pin (any thread)"""
+        now_ns = time.monotonic_ns()
+        pins = {}
+        for pin, slot in self.pin_slots.items():
+            level, since_ns, edges = slot.snapshot()
+            pins[pin] = {'device_name': self.pin_devices[pin],
+                         'state': 'HIGH' if level else 'LOW',
+                         'held_sec': round(max(now_ns - since_ns, 0) / 1e9, 3),
+                         'edges': edges}
+        return pins
+    
+    def get_stats(self):
+        """Runtime statistics of the capture/send pipeline"""
+        stats = self.pipeline.get_stats()
+        stats.update(self.source.get_stats())
+        stats.update(self.debouncer.get_stats())
+        if self.ring:
+            stats['ring_published'] = self.ring.write_seq
+        if self.chatter:
+            stats.update(self.chatter.get_stats())
+        stats.update(self.channel.get_stats())
+        stats.update(self.network_manager.get_stats())
+        if self.multipaths and not self.fanout:
+            stats.update(self.multipaths[0].get_stats())
+        if self.network_manager.link_monitor:
+            stats.update(self.network_manager.link_monitor.get_stats())
+        if self.journal:
+            stats.update(self.journal.get_stats())
+        return stats
+    
     def signal_handler(self, sig, frame):
         """Handle termination signals gracefully"""
         logger.info("Shutdown signal received, cleaning up...")
@@ -538,14 +4039,40 @@ class GPIOMonitor:
     
     def cleanup(self):
         """Clean up GPIO resources"""
-        for pin, button in self.buttons.items():
-            button.close()
+        if self.cleaned_up:
+            return
+        self.cleaned_up = True
+        if self.query:
+            self.query.close()
+        self.source.close()
+        self.debouncer.close()
+        if self.ring:
+            # No more edges arrive: publish those still queued and close
+            self.ring.close()
+        if self.recorder:
+            self.recorder.close()
+        self.pipeline.stop()
+        if self.fanout:
+            self.fanout.close()
+        else:
+            # Events still waiting for an ack would otherwise leave with the process
+            self.channel.spill()
+        if self.journal:
+            self.journal.close()
+        self.session.close()
+        if self.network_manager.link_monitor:
+            self.network_manager.link_monitor.close()
         logger.info("GPIO resources cleaned up")
     
     def run(self):
         """Main loop to keep the program running"""
         logger.info(f"GPIO Monitor started on {self.device_name}")
         logger.info(f"Monitoring pins: {self.pins}")
+        if set(self.pin_devices.values()) != {self.device_name}:
+            stations = {}
+            for pin, name in self.pin_devices.items():
+                stations.setdefault(name, []).append(pin)
+            logger.info(f"Logical stations: {stations}")
         logger.info(f"Will connect to server: {self.server_ip}:{self.server_port}")
         
         # Test initial network connectivity
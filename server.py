@@ -0,0 +1,316 @@
+#!/usr/bin/env python3
+"""
+Reference Andon collector
+Accepts station sessions using the protocol in andon_protocol.py (framed
+sessions with JSON or bin1 batches and sequence-numbered acknowledgements)
+as well as legacy one-connection-per-event clients, validates events and
+acknowledges them. Accepted events are written as JSON lines.
+
+Built on asyncio so a single process can hold thousands of concurrent
+station sessions. Serves both as a local stand-in for testing and as a
+baseline for sizing the production collector.
+"""
+
+import argparse
+import asyncio
+import json
+import logging
+import resource
+import signal
+import sys
+import time
+
+from andon_protocol import (FRAME_HEADER, MAX_FRAME_SIZE, PROTOCOL_VERSION, SUPPORTED_ENCODINGS,
+                            BIN1_MAGIC, ProtocolError, TimestampFormatter, decode_bin1)
+
+logger = logging.getLogger('andon_collector')
+
+LEGACY_MAX_SIZE = 64 * 1024
+VALID_STATES = frozenset(('HIGH', 'LOW', 'CHATTER', 'CONNECTIVITY_RESTORED'))
+
+class DeviceState:
+    """Delivery state of one station, shared by all of its sessions"""
+    def __init__(self, name):
+        self.name = name
+        self.cum_ack = 0  # every seq <= cum_ack has been received
+        self.received = set()  # received seqs above cum_ack
+        self.sessions = 0
+        self.events = 0
+        self.duplicates = 0
+    
+    def advance_base(self, base):
+        """The station will never send anything below base again"""
+        if base - 1 > self.cum_ack:
+            self.cum_ack = base - 1
+            self.received = {seq for seq in self.received if seq > self.cum_ack}
+            self._advance()
+    
+    def accept(self, seq):
+        """Record seq; returns False if it was already received"""
+        if seq <= self.cum_ack or seq in self.received:
+            self.duplicates += 1
+            return False
+        self.received.add(seq)
+        self._advance()
+        return True
+    
+    def _advance(self):
+        while self.cum_ack + 1 in self.received:
+            self.cum_ack += 1
+            self.received.discard(self.cum_ack)
+    
+    def ack_message(self):
+        sack = []
+        for seq in sorted(self.received):
+            if sack and sack[-1][1] == seq - 1:
+                sack[-1][1] = seq
+            else:
+                sack.append([seq, seq])
+        return {'type': 'ack', 'ack': self.cum_ack, 'sack': sack}
+
+class EventSink:
+    """Writes accepted events as JSON lines and keeps throughput counters"""
+    def __init__(self, output):
+        self.output = output
+        self.formatter = TimestampFormatter()
+        self.accepted = 0
+        self.rejected = 0
+    
+    def write(self, event):
+        if 'timestamp' not in event and 'ts_ms' in event:
+            event['timestamp'] = self.formatter.format(event['ts_ms'])
+        self.accepted += 1
+        if self.output:
+            self.output.write(json.dumps(event) + '\n')
+    
+    def flush(self):
+        if self.output:
+            self.output.flush()
+
+def validate_event(event):
+    """Return an error string if the event is malformed, otherwise None"""
+    if not isinstance(event, dict):
+        return "event is not an object"
+    if not isinstance(event.get('device_name'), str) or not event['device_name']:
+        return "missing device_name"
+    if not isinstance(event.get('pin'), int):
+        return "pin must be an integer"
+    if event.get('state') not in VALID_STATES:
+        return f"unknown state {event.get('state')!r}"
+    if not isinstance(event.get('time_diff_sec'), (int, float)) or event['time_diff_sec'] < 0:
+        return "time_diff_sec must be a non-negative number"
+    return None
+
+class Collector:
+    def __init__(self, sink, stats_interval=60):
+        self.sink = sink
+        self.stats_interval = stats_interval
+        self.devices = {}
+        self.sessions = 0
+        self.legacy_events = 0
+        self.frames = 0
+    
+    def device(self, name):
+        state = self.devices.get(name)
+        if state is None:
+            state = self.devices[name] = DeviceState(name)
+        return state
+    
+    async def handle_connection(self, reader, writer):
+        peer = writer.get_extra_info('peername')
+        try:
+            first = await reader.readexactly(1)
+            if first == b'{':
+                await self.handle_legacy(first, reader, writer)
+            else:
+                await self.handle_session(first, reader, writer, peer)
+        except (asyncio.IncompleteReadError, ConnectionError):
+            pass
+        except ProtocolError as e:
+            logger.warning(f"Protocol error from {peer}: {e}")
+        except Exception as e:
+            logger.error(f"Error handling connection from {peer}: {e}")
+        finally:
+            writer.close()
+    
+    async def handle_legacy(self, data, reader, writer):
+        """One JSON object per connection, answered with OK (pre-framing stations)"""
+        buffer = bytearray(data)
+        while True:
+            try:
+                event = json.loads(buffer)
+                break
+            except ValueError:
+                if len(buffer) > LEGACY_MAX_SIZE:
+                    raise ProtocolError("Legacy message too large")
+            chunk = await reader.read(4096)
+            if not chunk:
+                raise ProtocolError("Connection closed before a complete JSON object")
+            buffer.extend(chunk)
+        
+        error = validate_event(event)
+        if error:
+            self.sink.rejected += 1
+            logger.warning(f"Rejected legacy event: {error}")
+            writer.write(b'ERROR')
+        else:
+            self.legacy_events += 1
+            self.sink.write(event)
+            writer.write(b'OK')
+        await writer.drain()
+    
+    async def read_frame(self, reader, first=b''):
+        header = first + await reader.readexactly(FRAME_HEADER.size - len(first))
+        (length,) = FRAME_HEADER.unpack(header)
+        if length > MAX_FRAME_SIZE:
+            raise ProtocolError(f"Frame of {length} bytes exceeds limit")
+        return await reader.readexactly(length)
+    
+    @staticmethod
+    def write_frame(writer, message):
+        payload = json.dumps(message).encode('utf-8')
+        writer.write(FRAME_HEADER.pack(len(payload)) + payload)
+    
+    async def handle_session(self, first, reader, writer, peer):
+        """Framed session: hello, then batches acknowledged by sequence number"""
+        hello = json.loads(await self.read_frame(reader, first))
+        if hello.get('type') != 'hello' or not isinstance(hello.get('device_name'), str):
+            raise ProtocolError(f"Expected hello, got {hello}")
+        if hello.get('protocol') != PROTOCOL_VERSION:
+            raise ProtocolError(f"Unsupported protocol version {hello.get('protocol')}")
+        
+        device = self.device(hello['device_name'])
+        encoding = next((e for e in hello.get('encodings', []) if e in SUPPORTED_ENCODINGS), 'json')
+        self.write_frame(writer, {'type': 'welcome', 'protocol': PROTOCOL_VERSION,
+                                  'encoding': encoding, 'ack': device.cum_ack})
+        await writer.drain()
+        
+        self.sessions += 1
+        device.sessions += 1
+        logger.info(f"Session from {device.name} at {peer} ({encoding})")
+        try:
+            while True:
+                payload = await self.read_frame(reader)
+                self.frames += 1
+                
+                if payload[:1] == bytes((BIN1_MAGIC,)):
+                    base, events = decode_bin1(payload, device.name)
+                else:
+                    message = json.loads(payload)
+                    kind = message.get('type')
+                    if kind == 'notice':
+                        self.accept_unsequenced(message.get('event'))
+                        continue
+                    if kind != 'batch':
+                        raise ProtocolError(f"Unexpected message type {kind!r}")
+                    base, events = message.get('base', 0), message.get('events', [])
+                
+                self.accept_batch(device, base, events)
+                self.write_frame(writer, device.ack_message())
+                await writer.drain()
+        finally:
+            self.sessions -= 1
+            device.sessions -= 1
+            logger.info(f"Session from {device.name} at {peer} closed")
+    
+    def accept_unsequenced(self, event):
+        error = validate_event(event)
+        if error:
+            self.sink.rejected += 1
+            logger.warning(f"Rejected notice: {error}")
+        else:
+            self.sink.write(event)
+    
+    def accept_batch(self, device, base, events):
+        if not isinstance(base, int) or not isinstance(events, list):
+            raise ProtocolError("Malformed batch")
+        device.advance_base(base)
+        
+        for event in events:
+            seq = event.get('seq') if isinstance(event, dict) else None
+            if not isinstance(seq, int):
+                raise ProtocolError("Event without sequence number")
+            if not device.accept(seq):
+                continue
+            
+            # Malformed events are still acknowledged, retransmitting them would not help
+            error = validate_event(event)
+            if error:
+                self.sink.rejected += 1
+                logger.warning(f"Rejected event {seq} from {device.name}: {error}")
+                continue
+            device.events += 1
+            self.sink.write(event)
+    
+    async def stats_loop(self):
+        last_accepted = 0
+        last_time = time.monotonic()
+        while True:
+            await asyncio.sleep(self.stats_interval)
+            self.sink.flush()
+            now = time.monotonic()
+            rate = (self.sink.accepted - last_accepted) / (now - last_time)
+            last_accepted, last_time = self.sink.accepted, now
+            duplicates = sum(device.duplicates for device in self.devices.values())
+            logger.info(f"Sessions: {self.sessions}, devices: {len(self.devices)}, "
+                        f"events: {self.sink.accepted} ({rate:.1f}/s), legacy: {self.legacy_events}, "
+                        f"duplicates: {duplicates}, rejected: {self.sink.rejected}")
+
+def raise_file_limit():
+    """Each station session needs a file descriptor; use the hard limit"""
+    soft, hard = resource.getrlimit(resource.RLIMIT_NOFILE)
+    if soft < hard:
+        try:
+            resource.setrlimit(resource.RLIMIT_NOFILE, (hard, hard))
+        except (ValueError, OSError) as e:
+            logger.warning(f"Could not raise open file limit: {e}")
+    return resource.getrlimit(resource.RLIMIT_NOFILE)[0]
+
+async def serve(args):
+    output = None
+    if args.output == '-':
+        output = sys.stdout
+    elif args.output:
+        output = open(args.output, 'a')
+    
+    collector = Collector(EventSink(output), args.stats_interval)
+    server = await asyncio.start_server(collector.handle_connection, args.host, args.port,
+                                        backlog=args.backlog, reuse_address=True)
+    logger.info(f"Collector listening on {args.host}:{args.port} "
+                f"(file limit {raise_file_limit()})")
+    
+    stop = asyncio.Event()
+    loop = asyncio.get_running_loop()
+    for sig in (signal.SIGINT, signal.SIGTERM):
+        loop.add_signal_handler(sig, stop.set)
+    
+    stats = asyncio.create_task(collector.stats_loop())
+    async with server:
+        await stop.wait()
+    stats.cancel()
+    collector.sink.flush()
+    logger.info("Collector stopped")
+
+def main():
+    parser = argparse.ArgumentParser(description="Reference Andon collector")
+    parser.add_argument('--host', default='0.0.0.0')
+    parser.add_argument('--port', type=int, default=5000)
+    parser.add_argument('--output', default='-', help="JSON lines file for accepted events ('-' = stdout, '' = discard)")
+    parser.add_argument('--backlog', type=int, default=4096, help='listen backlog')
+    parser.add_argument('--stats-interval', type=float, default=60, help='seconds between statistics log lines')
+    parser.add_argument('--verbose', action='store_true')
+    args = parser.parse_args()
+    
+    logging.basicConfig(level=logging.DEBUG if args.verbose else logging.INFO,
+                        format='%(asctime)s - %(levelname)s - %(message)s', stream=sys.stderr)
+    
+    try:
+        import uvloop
+        uvloop.install()
+    except ImportError:
+        pass
+    
+    asyncio.run(serve(args))
+
+if __name__ == "__main__":
+    main()